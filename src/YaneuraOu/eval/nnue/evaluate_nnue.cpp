@@ -242,6 +242,20 @@ Value evaluate(const Position& pos) {
   return score;
 }
 
+// 指し手で変化する特徴量の重みを読み込み始めておく
+void prefetch_nnue(const Position& pos, const ChangedLists& cl) {
+#if defined(EVAL_NNUE_HALFKP)
+  const Square sq_k[2] = {pos.kingSquare(Black), inverse(pos.kingSquare(White))};
+  for (size_t i = 0; i < cl.size; ++i) {
+    for (const auto perspective : COLOR) {
+      const auto base = static_cast<NNUE::IndexType>(fe_end) * static_cast<NNUE::IndexType>(sq_k[perspective]);
+      NNUE::feature_transformer->PrefetchColumn(base + cl.clistpair[i].oldlist[perspective]);
+      NNUE::feature_transformer->PrefetchColumn(base + cl.clistpair[i].newlist[perspective]);
+    }
+  }
+#endif
+}
+
 // 差分計算ができるなら進める
 void evaluate_with_no_return(const Position& pos) {
   NNUE::UpdateAccumulatorIfPossible(pos);
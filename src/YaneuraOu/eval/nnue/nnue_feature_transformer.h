@@ -79,6 +79,14 @@ class FeatureTransformer {
     return false;
   }
 
+  // 特徴量 index の重みの列を読み込み始めておく
+  void PrefetchColumn(IndexType index) const {
+    const char* column = reinterpret_cast<const char*>(&weights_[kHalfDimensions * index]);
+    for (std::size_t i = 0; i < kHalfDimensions * sizeof(WeightType); i += kCacheLineSize) {
+      prefetch((void*)(column + i));
+    }
+  }
+
   // 入力特徴量を変換する
   void Transform(const Position& pos, OutputType* output, bool refresh) const {
     if (refresh || !UpdateAccumulatorIfPossible(pos)) {
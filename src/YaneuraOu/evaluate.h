@@ -6,6 +6,8 @@
 
 #define BonaPieceExpansion 0
 
+struct ChangedLists;
+
 namespace Eval {
 
 	// 評価関数ファイルを読み込む。
@@ -26,6 +28,9 @@ namespace Eval {
 	// あるいは差分計算が不可能なときに呼び出される。
 	Value compute_eval(const Position& pos);
 
+	// 指し手で変化する特徴量 (cl) の重みを読み込み始めておく。
+	void prefetch_nnue(const Position& pos, const ChangedLists& cl);
+
 
 	// BonanzaでKKP/KPPと言うときのP(Piece)を表現する型。
 	// Σ KPPを求めるときに、39の地点の歩のように、升×駒種に対して一意な番号が必要となる。
@@ -93,15 +93,41 @@ typedef Stats<Move, NOT_USED, SQ_NB , PIECE_NB> CounterMoveHistory;
 //    Stockfishでは、[piece][to][captured piece type]の順。
 typedef Stats<int16_t, 10692, SQ_NB, PIECE_NB , PIECE_TYPE_NB> CapturePieceToHistory;
 
+// 駒の添字を詰めたもの。PIECE_NB(32) のうち実際に使うのは 0(駒無し) と先後の 14 種ずつなので、
+// 後手の駒(17～30)を 2 つ前にずらして 29 要素にする。
+// ContinuationHistory は [to][piece] の二重になっているので、全体で 2 割近く小さくなる。
+constexpr int COMPACT_PIECE_NB = 29;
+constexpr int compactPiece(const int pc) { return pc - ((pc >> 3) & 2); }
+
+// [piece] の次元を詰めた Stats。添字には詰める前の駒を渡す。
+template <typename T, int D>
+struct PieceStats : public std::array<StatsEntry<T, D>, COMPACT_PIECE_NB> {
+	typedef std::array<StatsEntry<T, D>, COMPACT_PIECE_NB> Base;
+	StatsEntry<T, D>& operator[](const int pc) { return Base::operator[](compactPiece(pc)); }
+	const StatsEntry<T, D>& operator[](const int pc) const { return Base::operator[](compactPiece(pc)); }
+	T* get() { return &this->at(0); }
+};
+
+// [to][piece] の Stats
+template <typename T, int D>
+struct PieceToStats : public std::array<PieceStats<T, D>, SQ_NB> {
+	T* get() { return this->at(0).get(); }
+
+	void fill(const T& v) {
+		T* p = get();
+		std::fill(p, p + sizeof(*this) / sizeof(*p), v);
+	}
+};
+
 /// PieceToHistoryは、ButterflyHistoryに似たものだが、指し手の[to][piece]で示される。
 // ※　Stockfishとは、添字の順番を入れ替えてあるので注意。
-typedef Stats<int16_t, 29952, SQ_NB , PIECE_NB> PieceToHistory;
+typedef PieceToStats<int16_t, 29952> PieceToHistory;
 
 /// ContinuationHistoryは、与えられた2つの指し手のhistoryを組み合わせたもので、
 // 普通、1手前によって与えられる現在の指し手(によるcombined history)
 // このnested history tableは、ButterflyBoardsの代わりに、PieceToHistoryをベースとしている。
 // ※　Stockfishとは、添字の順番を入れ替えてあるので注意。
-typedef Stats<PieceToHistory, NOT_USED, SQ_NB , PIECE_NB> ContinuationHistory;
+typedef PieceToStats<PieceToHistory, NOT_USED> ContinuationHistory;
 
 
 #endif // #ifndef YANE_MOVEPICK_H_INCLUDED
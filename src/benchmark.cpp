@@ -131,10 +131,17 @@ void benchmark(Position& pos, std::istream& is) {
 		std::istringstream is(str);
 		setOption(is);
 	}
+
+	// スレッドごとの history の大きさと、その初期化にかかる時間
+	const TimePoint clearStart = now();
     Search::clear();
+	std::cout << "history size = " << (sizeof(Thread) >> 10) << " KB/thread"
+			  << " (continuationHistory " << (sizeof(Threads.main()->continuationHistory) >> 10) << " KB)"
+			  << ", clear = " << now() - clearStart << " ms" << std::endl;
 
 	std::ifstream ifs("benchmark.sfen");
 	std::string sfen;
+	uint64_t nodes = 0;
 	while (std::getline(ifs, sfen)) {
 		std::cout << sfen << std::endl;
 		std::istringstream ss_sfen(sfen);
@@ -142,6 +149,26 @@ void benchmark(Position& pos, std::istream& is) {
 		std::istringstream ss_go("byoyomi 10000");
 		go(pos, ss_go);
 		Threads.main()->wait_for_search_finished();
+		nodes += Threads.nodes_searched();
+#if defined USE_SEARCH_STATS
+		// 局面ごとの探索の統計をファイルに追記する。
+		std::ofstream ofs("search_stats.txt", std::ios::app);
+		ofs << sfen << "\n" << Search::searchStatsToString() << "\n" << std::endl;
+#endif
+	}
+
+#if defined USE_MATE_3PLY
+	// 3手詰め判定の成功率と、判定に使った局面数の全体に対する割合
+	uint64_t probes = 0, hits = 0, mateNodes = 0;
+	for (Thread* th : Threads) {
+		probes += th->mate3Probes;
+		hits += th->mate3Hits;
+		mateNodes += th->mate3Nodes;
 	}
+	std::cout << "mate3 probes = " << probes
+			  << ", hits = " << hits << " (" << (probes ? 100.0 * hits / probes : 0.0) << "%)"
+			  << ", nodes = " << mateNodes << " (" << (nodes ? 100.0 * mateNodes / nodes : 0.0) << "% of " << nodes << ")"
+			  << std::endl;
+#endif
 }
 #endif
\ No newline at end of file
@@ -227,6 +227,11 @@ const Bitboard InFrontMask[ColorNum][RankNum] = {
 
 // これらは一度値を設定したら二度と変更しない。
 // 本当は const 化したい。
+#if defined USE_QUGIY_ATTACKS
+alignas(32) Bitboard QugiyRookMask[SquareNum][2];
+alignas(32) Bitboard QugiyBishopMask[SquareNum][4];
+u64 QugiyLanceMask[ColorNum][SquareNum];
+#endif
 #if defined HAVE_BMI2
 Bitboard RookAttack[495616];
 #else
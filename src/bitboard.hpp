@@ -24,6 +24,10 @@ public:
 		this->p_[0] = v0;
 		this->p_[1] = v1;
 	}
+#if defined (HAVE_SSE2) || defined (HAVE_SSE4)
+	explicit Bitboard(const __m128i m) { _mm_store_si128(&this->m_, m); }
+	__m128i m() const { return m_; }
+#endif
 	u64 p(const int index) const { return p_[index]; }
 	void set(const int index, const u64 val) { p_[index] = val; }
 	u64 merge() const { return this->p(0) | this->p(1); }
@@ -235,6 +239,56 @@ inline Bitboard setMaskBB(const Square sq) { return SetMaskBB[sq]; }
 inline Bitboard allOneBB() { return Bitboard(UINT64_C(0x7fffffffffffffff), UINT64_C(0x000000000003ffff)); }
 inline Bitboard allZeroBB() { return Bitboard(0, 0); }
 
+// 2 つの Bitboard を並べて、同じ演算を同時に行う。
+// 先後の 2 つの視点や、飛車と角の 2 つの利きのように、組になる計算に使う。
+// AVX2 が使えるときは __m256i 1 つで扱い、Bitboard 2 回分の演算が 1 命令になる。
+class Bitboard256 {
+public:
+	Bitboard256() {}
+#if defined HAVE_AVX2
+	Bitboard256(const Bitboard& b0, const Bitboard& b1) : m_(_mm256_set_m128i(b1.m(), b0.m())) {}
+	// 2 つとも同じ Bitboard
+	explicit Bitboard256(const Bitboard& b) : m_(_mm256_broadcastsi128_si256(b.m())) {}
+
+	Bitboard bb(const int index) const {
+		return Bitboard(index == 0 ? _mm256_castsi256_si128(m_) : _mm256_extracti128_si256(m_, 1));
+	}
+	// 2 つの Bitboard の |
+	Bitboard merge() const { return Bitboard(_mm_or_si128(_mm256_castsi256_si128(m_), _mm256_extracti128_si256(m_, 1))); }
+	bool isAny() const { return !_mm256_testz_si256(m_, m_); }
+
+	Bitboard256& operator &= (const Bitboard256& rhs) { m_ = _mm256_and_si256(m_, rhs.m_); return *this; }
+	Bitboard256& operator |= (const Bitboard256& rhs) { m_ = _mm256_or_si256 (m_, rhs.m_); return *this; }
+	Bitboard256& operator ^= (const Bitboard256& rhs) { m_ = _mm256_xor_si256(m_, rhs.m_); return *this; }
+	Bitboard256& andEqualNot(const Bitboard256& rhs) { m_ = _mm256_andnot_si256(rhs.m_, m_); return *this; }
+	Bitboard256 notThisAnd(const Bitboard256& rhs) const { Bitboard256 tmp; tmp.m_ = _mm256_andnot_si256(m_, rhs.m_); return tmp; }
+#else
+	Bitboard256(const Bitboard& b0, const Bitboard& b1) { b_[0] = b0; b_[1] = b1; }
+	explicit Bitboard256(const Bitboard& b) { b_[0] = b; b_[1] = b; }
+
+	Bitboard bb(const int index) const { return b_[index]; }
+	Bitboard merge() const { return b_[0] | b_[1]; }
+	bool isAny() const { return b_[0].isAny() || b_[1].isAny(); }
+
+	Bitboard256& operator &= (const Bitboard256& rhs) { b_[0] &= rhs.b_[0]; b_[1] &= rhs.b_[1]; return *this; }
+	Bitboard256& operator |= (const Bitboard256& rhs) { b_[0] |= rhs.b_[0]; b_[1] |= rhs.b_[1]; return *this; }
+	Bitboard256& operator ^= (const Bitboard256& rhs) { b_[0] ^= rhs.b_[0]; b_[1] ^= rhs.b_[1]; return *this; }
+	Bitboard256& andEqualNot(const Bitboard256& rhs) { b_[0].andEqualNot(rhs.b_[0]); b_[1].andEqualNot(rhs.b_[1]); return *this; }
+	Bitboard256 notThisAnd(const Bitboard256& rhs) const { return Bitboard256(b_[0].notThisAnd(rhs.b_[0]), b_[1].notThisAnd(rhs.b_[1])); }
+#endif
+	explicit operator bool() const { return isAny(); }
+	Bitboard256 operator & (const Bitboard256& rhs) const { return Bitboard256(*this) &= rhs; }
+	Bitboard256 operator | (const Bitboard256& rhs) const { return Bitboard256(*this) |= rhs; }
+	Bitboard256 operator ^ (const Bitboard256& rhs) const { return Bitboard256(*this) ^= rhs; }
+
+private:
+#if defined HAVE_AVX2
+	__m256i m_;
+#else
+	Bitboard b_[2];
+#endif
+};
+
 extern const int RookBlockBits[SquareNum];
 extern const int BishopBlockBits[SquareNum];
 extern const int RookShiftBits[SquareNum];
@@ -367,6 +421,16 @@ template <Color C, Rank R> inline Bitboard inFrontMask() {
 			   : /*R == Rank9 ?*/ InFrontOfRank9White));
 }
 
+#if defined USE_QUGIY_ATTACKS
+// Qugiy の利きの計算で使う、利きの方向ごとの障害物が無いときの利き。
+// [0], [1] の組と [2], [3] の組をそれぞれ __m256i に読み込んで使う。
+// [1], [3] は bit の小さい方向の利きを byte 単位で逆順にしたもの。
+extern Bitboard QugiyRookMask[SquareNum][2];   // 横 [0]: DeltaW, [1]: DeltaE
+extern Bitboard QugiyBishopMask[SquareNum][4]; // [0]: DeltaSW, [1]: DeltaNE, [2]: DeltaNW, [3]: DeltaSE
+// 縦の利きは、筋が Bitboard の片方の u64 に収まるので、そちらの u64 だけで計算する。
+extern u64 QugiyLanceMask[ColorNum][SquareNum];
+#endif
+
 // メモリ節約の為、1次元配列にして無駄が無いようにしている。
 #if defined HAVE_BMI2
 extern Bitboard RookAttack[495616];
@@ -399,7 +463,69 @@ extern Bitboard SilverCheckTable[ColorNum][SquareNum];
 extern Bitboard KnightCheckTable[ColorNum][SquareNum];
 extern Bitboard LanceCheckTable[ColorNum][SquareNum];
 
-#if defined HAVE_BMI2
+#if defined USE_QUGIY_ATTACKS
+// Qugiy の方法による遠方駒の利き
+// x = occupied & (ある方向の障害物が無いときの利き) とすると、
+// (x ^ (x - 1)) & (障害物が無いときの利き) が bit の大きい方向の最初の駒までの利きになる。
+// bit の小さい方向の利きは byte 単位で逆順にしてから同じ計算をする。
+// 横と斜めの方向は隣のマスと bit が 8 以上離れていて同じ byte に入らないので、byte 単位の逆順で方向だけが逆になる。
+// 2 方向を __m256i の上下の 128 bit で同時に計算する。
+
+// 下位 128 bit はそのまま、上位 128 bit は byte 単位で逆順にする shuffle
+inline __m256i qugiyShuffle() {
+	return _mm256_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+						   15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+}
+inline __m256i qugiyOccupied(const Bitboard& occupied) {
+	return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(occupied.m()), qugiyShuffle());
+}
+// 上下の 128 bit をそれぞれ 1 つの整数として x ^ (x - 1) を計算する。
+// 下位 64 bit が 0 のときだけ上位 64 bit に繰り下がる。
+inline __m256i qugiyLowestBitAndBelow(const __m256i x) {
+	const __m256i borrow = _mm256_slli_si256(_mm256_cmpeq_epi64(x, _mm256_setzero_si256()), 8);
+	const __m256i decrement = _mm256_or_si256(borrow, _mm256_set_epi64x(0, -1, 0, -1));
+	return _mm256_xor_si256(x, _mm256_add_epi64(x, decrement));
+}
+inline __m256i qugiyAttack(const __m256i occ, const Bitboard* mask) {
+	const __m256i m = _mm256_load_si256(reinterpret_cast<const __m256i*>(mask));
+	return _mm256_and_si256(qugiyLowestBitAndBelow(_mm256_and_si256(occ, m)), m);
+}
+// 上位 128 bit を元の順に戻して、下位 128 bit と合わせる。
+inline Bitboard qugiyMerge(const __m256i attack) {
+	const __m256i t = _mm256_shuffle_epi8(attack, qugiyShuffle());
+	return Bitboard(_mm_or_si128(_mm256_castsi256_si128(t), _mm256_extracti128_si256(t, 1)));
+}
+// 縦の利き (香車の利き) の u64
+inline u64 qugiyLanceAttack(const Color c, const Square sq, const u64 occupied) {
+	const u64 mask = QugiyLanceMask[c][sq];
+	const u64 x = occupied & mask;
+	if (c == Black)
+		// bit の小さい方向。最初の駒は x の最上位の bit。
+		// bit 0 を立てておくと、駒が無いときに 1 段目まで利く。(bit 0 はどの筋でも 1 段目以上)
+		return mask & (~UINT64_C(0) << msb(x | 1));
+	return (x ^ (x - 1)) & mask;
+}
+
+inline Bitboard rookAttackFile(const Square sq, const Bitboard& occupied) {
+	const int part = Bitboard::part(sq);
+	const u64 occ = occupied.p(part);
+	const u64 attack = qugiyLanceAttack(Black, sq, occ) | qugiyLanceAttack(White, sq, occ);
+	return (part == 0 ? Bitboard(attack, 0) : Bitboard(0, attack));
+}
+inline Bitboard rookAttack(const Square sq, const Bitboard& occupied) {
+	return qugiyMerge(qugiyAttack(qugiyOccupied(occupied), QugiyRookMask[sq])) | rookAttackFile(sq, occupied);
+}
+inline Bitboard bishopAttack(const Square sq, const Bitboard& occupied) {
+	const __m256i occ = qugiyOccupied(occupied);
+	return qugiyMerge(_mm256_or_si256(qugiyAttack(occ, QugiyBishopMask[sq] + 0),
+									  qugiyAttack(occ, QugiyBishopMask[sq] + 2)));
+}
+inline Bitboard lanceAttack(const Color c, const Square sq, const Bitboard& occupied) {
+	const int part = Bitboard::part(sq);
+	const u64 attack = qugiyLanceAttack(c, sq, occupied.p(part));
+	return (part == 0 ? Bitboard(attack, 0) : Bitboard(0, attack));
+}
+#elif defined HAVE_BMI2
 // PEXT bitboard.
 inline u64 occupiedToIndex(const Bitboard& block, const Bitboard& mask) {
 	return _pext_u64(block.merge(), mask.merge());
@@ -429,6 +555,7 @@ inline Bitboard bishopAttack(const Square sq, const Bitboard& occupied) {
 	return BishopAttack[BishopAttackIndex[sq] + occupiedToIndex(block, BishopMagic[sq], BishopShiftBits[sq])];
 }
 #endif
+#if !defined USE_QUGIY_ATTACKS
 // todo: 香車の筋がどこにあるか先に分かっていれば、Bitboard の片方の変数だけを調べれば良くなる。
 inline Bitboard lanceAttack(const Color c, const Square sq, const Bitboard& occupied) {
 	const int part = Bitboard::part(sq);
@@ -441,6 +568,7 @@ inline Bitboard rookAttackFile(const Square sq, const Bitboard& occupied) {
 	const int index = (occupied.p(part) >> Slide[sq]) & 127;
 	return LanceAttack[Black][sq][index] | LanceAttack[White][sq][index];
 }
+#endif
 inline Bitboard goldAttack(const Color c, const Square sq) { return GoldAttack[c][sq]; }
 inline Bitboard silverAttack(const Color c, const Square sq) { return SilverAttack[c][sq]; }
 inline Bitboard knightAttack(const Color c, const Square sq) { return KnightAttack[c][sq]; }
@@ -4,6 +4,19 @@
 #include "usi.hpp"
 #include "thread.hpp"
 #include "search.hpp"
+#include <queue>
+
+#if defined _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 MT64bit Book::mt64bit_; // 定跡のhash生成用なので、seedは固定でデフォルト値を使う。
 Key Book::ZobPiece[PieceNone][SquareNum];
@@ -23,52 +36,84 @@ void Book::init() {
 }
 
 bool Book::open(const char* fName) {
-	fileName_ = "";
-
-	if (is_open())
-		close();
+	close();
 
-	std::ifstream::open(fName, std::ifstream::in | std::ifstream::binary | std::ios::ate);
-
-	if (!is_open())
+	size_t fileSize = 0;
+	void* addr = nullptr;
+#if defined _WIN32
+	const HANDLE file = CreateFileA(fName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
 		return false;
+	LARGE_INTEGER li;
+	if (GetFileSizeEx(file, &li))
+		fileSize = static_cast<size_t>(li.QuadPart);
+	if (fileSize != 0) {
+		// view が残っていれば mapping を閉じても良い。
+		const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping != nullptr) {
+			addr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+		}
+	}
+	CloseHandle(file);
+#else
+	const int fd = ::open(fName, O_RDONLY);
+	if (fd == -1)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) == 0)
+		fileSize = static_cast<size_t>(st.st_size);
+	if (fileSize != 0) {
+		addr = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+		if (addr == MAP_FAILED)
+			addr = nullptr;
+	}
+	::close(fd);
+#endif
 
-	size_ = tellg() / sizeof(BookEntry);
-
-	if (!good()) {
+	if (fileSize != 0 && addr == nullptr) {
 		std::cerr << "Failed to open book file " << fName  << std::endl;
 		exit(EXIT_FAILURE);
 	}
 
+	entries_ = static_cast<const BookEntry*>(addr);
+	mappedSize_ = fileSize;
+	size_ = fileSize / sizeof(BookEntry);
+
+	// 索引を作る。各区間の先頭だけを二分探索するので、ファイル全体は読まない。
+	const auto less = [](const BookEntry& entry, const Key key) { return entry.key < key; };
+	index_.resize((static_cast<size_t>(1) << IndexBits) + 1);
+	const BookEntry* it = entries_;
+	for (size_t i = 0; i < (static_cast<size_t>(1) << IndexBits); ++i) {
+		it = std::lower_bound(it, entries_ + size_, static_cast<Key>(i) << (64 - IndexBits), less);
+		index_[i] = it - entries_;
+	}
+	index_.back() = size_;
+
 	fileName_ = fName;
 	return true;
 }
 
-void Book::binary_search(const Key key) {
-	size_t low = 0;
-	size_t high = size_ - 1;
-	size_t mid;
-	BookEntry entry;
-
-	while (low < high && good()) {
-		mid = (low + high) / 2;
-
-		assert(mid >= low && mid < high);
-
-		// std::ios_base::beg はストリームの開始位置を指す。
-		// よって、ファイルの開始位置から mid * sizeof(BookEntry) バイト進んだ位置を指す。
-		seekg(mid * sizeof(BookEntry), std::ios_base::beg);
-		read(reinterpret_cast<char*>(&entry), sizeof(entry));
-
-		if (key <= entry.key)
-			high = mid;
-		else
-			low = mid + 1;
+void Book::close() {
+	if (entries_ != nullptr) {
+#if defined _WIN32
+		UnmapViewOfFile(entries_);
+#else
+		munmap(const_cast<BookEntry*>(entries_), mappedSize_);
+#endif
 	}
+	entries_ = nullptr;
+	size_ = 0;
+	mappedSize_ = 0;
+	index_.clear();
+	fileName_ = "";
+}
 
-	assert(low == high);
-
-	seekg(low * sizeof(BookEntry), std::ios_base::beg);
+// key 以上の最初の要素。
+const BookEntry* Book::lower_bound(const Key key) const {
+	const size_t i = key >> (64 - IndexBits);
+	return std::lower_bound(entries_ + index_[i], entries_ + index_[i + 1], key,
+							[](const BookEntry& entry, const Key k) { return entry.key < k; });
 }
 
 Key Book::bookKey(const Position& pos) {
@@ -87,8 +132,22 @@ Key Book::bookKey(const Position& pos) {
 	return key;
 }
 
+namespace {
+	// BookEntry::fromToPro を pos での指し手にする。
+	Move fromToProToMove(const Position& pos, const u16 fromToPro) {
+		const Move tmp = Move(fromToPro);
+		const Square to = tmp.to();
+		if (tmp.isDrop())
+			return makeDropMove(tmp.pieceTypeDropped(), to);
+		const Square from = tmp.from();
+		const PieceType ptFrom = pieceToPieceType(pos.piece(from));
+		if (tmp.isPromotion())
+			return makeCapturePromoteMove(ptFrom, from, to, pos);
+		return makeCaptureMove(ptFrom, from, to, pos);
+	}
+}
+
 std::tuple<Move, Score> Book::probe(const Position& pos, const std::string& fName, const bool pickBest) {
-	BookEntry entry;
 	u16 best = 0;
 	u32 sum = 0;
 	Move move = Move::moveNone();
@@ -99,10 +158,9 @@ std::tuple<Move, Score> Book::probe(const Position& pos, const std::string& fNam
 	if (fileName_ != fName && !open(fName.c_str()))
 		return std::make_tuple(Move::moveNone(), ScoreNone);
 
-	binary_search(key);
-
 	// 現在の局面における定跡手の数だけループする。
-	while (read(reinterpret_cast<char*>(&entry), sizeof(entry)), entry.key == key && good()) {
+	for (const BookEntry* it = lower_bound(key); it != entries_ + size_ && it->key == key; ++it) {
+		const BookEntry& entry = *it;
 		best = std::max(best, entry.count);
 		sum += entry.count;
 
@@ -112,21 +170,7 @@ std::tuple<Move, Score> Book::probe(const Position& pos, const std::string& fNam
 			&& ((random_.random() % sum < entry.count)
 				|| (pickBest && entry.count == best)))
 		{
-			const Move tmp = Move(entry.fromToPro);
-			const Square to = tmp.to();
-			if (tmp.isDrop()) {
-				const PieceType ptDropped = tmp.pieceTypeDropped();
-				move = makeDropMove(ptDropped, to);
-			}
-			else {
-				const Square from = tmp.from();
-				const PieceType ptFrom = pieceToPieceType(pos.piece(from));
-				const bool promo = tmp.isPromotion();
-				if (promo)
-					move = makeCapturePromoteMove(ptFrom, from, to, pos);
-				else
-					move = makeCaptureMove(ptFrom, from, to, pos);
-			}
+			move = fromToProToMove(pos, entry.fromToPro);
 			score = entry.score;
 		}
 	}
@@ -139,32 +183,115 @@ inline bool countCompare(const BookEntry& b1, const BookEntry& b2) {
 }
 
 #if !defined MINIMUL
-// 以下のようなフォーマットが入力される。
-// <棋譜番号> <日付> <先手名> <後手名> <0:引き分け, 1:先手勝ち, 2:後手勝ち> <総手数> <棋戦名前> <戦形>
-// <CSA1行形式の指し手>
-//
-// (例)
-// 1 2003/09/08 羽生善治 谷川浩司 2 126 王位戦 その他の戦型
-// 7776FU3334FU2726FU4132KI
-//
-// 勝った方の手だけを定跡として使うこととする。
-// 出現回数がそのまま定跡として使う確率となる。
-// 基本的には棋譜を丁寧に選別した上で定跡を作る必要がある。
-// MAKE_SEARCHED_BOOK を on にしていると、定跡生成に非常に時間が掛かる。
-void makeBook(Position& pos, std::istringstream& ssCmd) {
-	std::string fileName;
-	ssCmd >> fileName;
-	std::ifstream ifs(fileName.c_str(), std::ios::binary);
-	if (!ifs) {
-		std::cout << "I cannot open " << fileName << std::endl;
-		return;
+#if defined MAKE_SEARCHED_BOOK
+namespace {
+	struct BookScoreOptions {
+		std::string limit = "byoyomi 1000"; // go に渡す探索の制限
+		bool clearEachSearch = false;        // 探索毎に置換表などを消して、結果を探索順に依らないものにする。
+		int shardIndex = 0;
+		int shardNum = 1;
+		std::string checkpoint = "book_scores";
+	};
+
+	std::string checkpointFileName(const BookScoreOptions& opt, const int shardIndex) {
+		return opt.checkpoint + "_" + std::to_string(shardIndex) + ".txt";
 	}
-	std::string line;
-	std::map<Key, std::vector<BookEntry> > bookMap;
 
-	while (std::getline(ifs, line)) {
+	// bookMap の指し手を探索して点数を付ける。
+	// 全ての (局面, 指し手) を決まった順に並べ、番号 % shardNum == shardIndex のものだけを探索する。
+	// 探索した結果は 1 手毎に <checkpoint>_<shardIndex>.txt に "key fromToPro score" の形で追記する。
+	// 始めに全ての shard のファイルを読み、探索済みのものは飛ばすので、中断しても同じコマンドで再開出来る。
+	// 別々のプロセス (それぞれ置換表を持つ) で shard を分担すれば並列に点数付け出来る。
+	// 全ての指し手に点数が付いていれば true を返す。
+	bool scoreBook(Position& pos, std::map<Key, std::vector<BookEntry> >& bookMap,
+				   const std::map<Key, std::string>& sfens, const BookScoreOptions& opt)
+	{
+		std::map<std::pair<Key, u16>, Score> scored;
+		for (int i = 0; ; ++i) {
+			std::ifstream ifs(checkpointFileName(opt, i).c_str());
+			if (!ifs) {
+				if (i < opt.shardNum)
+					continue;
+				break;
+			}
+			// 書き込み途中で中断された行は改行が無いので読まない。
+			std::string line;
+			while (std::getline(ifs, line) && !ifs.eof()) {
+				std::istringstream ss(line);
+				Key key;
+				u16 fromToPro;
+				int score;
+				if (ss >> key >> fromToPro >> score)
+					scored[std::make_pair(key, fromToPro)] = static_cast<Score>(score);
+			}
+		}
+
+		size_t total = 0;
+		for (const auto& elem : bookMap)
+			total += elem.second.size();
+		std::cout << "book entries: " << total << ", already scored: " << scored.size() << std::endl;
+
+		// 中断された行の直後に続けて書かないように、改行で終わっていなければ改行を足してから追記する。
+		bool unterminated = false;
+		{
+			std::ifstream ifs(checkpointFileName(opt, opt.shardIndex).c_str(), std::ios::binary | std::ios::ate);
+			char c;
+			if (ifs && 0 < ifs.tellg() && ifs.seekg(-1, std::ios::end) && ifs.get(c))
+				unterminated = (c != '\n');
+		}
+		std::ofstream ofs(checkpointFileName(opt, opt.shardIndex).c_str(), std::ios::app);
+		if (unterminated)
+			ofs << std::endl;
+		size_t index = 0;
+		size_t remaining = 0;
+		size_t searched = 0;
+		for (auto& elem : bookMap) {
+			for (auto& be : elem.second) {
+				const size_t i = index++;
+				const auto it = scored.find(std::make_pair(be.key, be.fromToPro));
+				if (it != scored.end()) {
+					be.score = it->second;
+					continue;
+				}
+				if (static_cast<int>(i % opt.shardNum) != opt.shardIndex) {
+					++remaining;
+					continue;
+				}
+
+				pos.set(sfens.at(elem.first), Threads.main());
+				const Move move = fromToProToMove(pos, be.fromToPro);
+				StateInfo st;
+				pos.doMove(move, st);
+
+				if (opt.clearEachSearch)
+					Search::clear();
+				std::istringstream ssCmd(opt.limit);
+				go(pos, ssCmd);
+				Threads.main()->wait_for_search_finished();
+
+				// doMove してから search してるので点数が反転しているので直す。
+				// 相手に指し手が無ければ、この指し手で詰んでいる。
+				const Search::RootMove& rm = pos.thisThread()->rootMoves[0];
+				be.score = (rm.pv[0] ? -rm.score : mateIn(1));
+				ofs << be.key << " " << be.fromToPro << " " << static_cast<int>(be.score) << std::endl;
+				if (++searched % 100 == 0)
+					std::cout << "scored " << i + 1 << " / " << total << std::endl;
+			}
+		}
+
+		if (remaining != 0)
+			std::cout << remaining << " entries are left to other shards" << std::endl;
+		return remaining == 0;
+	}
+}
+#endif
+
+namespace {
+	// 棋譜 1 局分 (ヘッダ行と CSA1行形式の指し手の行) を再生し、記録する側の指し手毎に f(pos, key, move) を呼ぶ。
+	template <typename F>
+	void replayKifu(Position& pos, const std::string& header, std::string line, F f) {
 		std::string elem;
-		std::stringstream ss(line);
+		std::stringstream ss(header);
 		ss >> elem; // 棋譜番号を飛ばす。
 		ss >> elem; // 対局日を飛ばす。
 		ss >> elem; // 先手
@@ -177,10 +304,6 @@ void makeBook(Position& pos, std::istringstream& ssCmd) {
 		// 又は稲庭戦法側を記録していく。
 		const Color saveColor = winner;
 
-		if (!std::getline(ifs, line)) {
-			std::cout << "!!! header only !!!" << std::endl;
-			return;
-		}
 		pos.set(DefaultStartPositionSFEN, Threads.main());
 		StateStackPtr SetUpStates = StateStackPtr(new std::stack<StateInfo>());
 		while (!line.empty()) {
@@ -194,52 +317,100 @@ void makeBook(Position& pos, std::istringstream& ssCmd) {
 			line.erase(0, 6); // 先頭から6文字削除
 			if (pos.turn() == saveColor) {
 				// 先手、後手の内、片方だけを記録する。
-				const Key key = Book::bookKey(pos);
-				bool isFind = false;
-				if (bookMap.find(key) != bookMap.end()) {
-					for (std::vector<BookEntry>::iterator it = bookMap[key].begin();
-						 it != bookMap[key].end();
-						 ++it)
-					{
-						if (it->fromToPro == move.proFromAndTo()) {
-							++it->count;
-							if (it->count < 1)
-								--it->count; // 数えられる数の上限を超えたので元に戻す。
-							isFind = true;
-						}
+				f(pos, Book::bookKey(pos), move);
+			}
+			SetUpStates->push(StateInfo());
+			pos.doMove(move, SetUpStates->top());
+		}
+	}
+}
+
+// 以下のようなフォーマットが入力される。
+// <棋譜番号> <日付> <先手名> <後手名> <0:引き分け, 1:先手勝ち, 2:後手勝ち> <総手数> <棋戦名前> <戦形>
+// <CSA1行形式の指し手>
+//
+// (例)
+// 1 2003/09/08 羽生善治 谷川浩司 2 126 王位戦 その他の戦型
+// 7776FU3334FU2726FU4132KI
+//
+// 勝った方の手だけを定跡として使うこととする。
+// 出現回数がそのまま定跡として使う確率となる。
+// 基本的には棋譜を丁寧に選別した上で定跡を作る必要がある。
+// MAKE_SEARCHED_BOOK を on にしていると、定跡生成に非常に時間が掛かる。
+// その場合、棋譜を全て読んでから、まだ点数の無い指し手を探索する。
+// b <棋譜ファイル> [byoyomi <ms> | depth <depth> | nodes <nodes>] [shard <index> <num>] [checkpoint <prefix>]
+// depth, nodes を指定すると探索毎に置換表を消すので、結果が再現出来る。
+void makeBook(Position& pos, std::istringstream& ssCmd) {
+	std::string fileName;
+	ssCmd >> fileName;
+#if defined MAKE_SEARCHED_BOOK
+	BookScoreOptions scoreOpt;
+	std::string token;
+	while (ssCmd >> token) {
+		if (token == "byoyomi" || token == "depth" || token == "nodes") {
+			std::string value;
+			ssCmd >> value;
+			scoreOpt.limit = token + " " + value;
+			scoreOpt.clearEachSearch = (token != "byoyomi");
+		}
+		else if (token == "shard"     ) ssCmd >> scoreOpt.shardIndex >> scoreOpt.shardNum;
+		else if (token == "checkpoint") ssCmd >> scoreOpt.checkpoint;
+	}
+	if (scoreOpt.shardNum < 1 || scoreOpt.shardIndex < 0 || scoreOpt.shardNum <= scoreOpt.shardIndex) {
+		std::cout << "invalid shard " << scoreOpt.shardIndex << " " << scoreOpt.shardNum << std::endl;
+		return;
+	}
+	std::map<Key, std::string> sfens; // 探索する為に、key 毎に局面を 1 つ覚えておく。
+#endif
+	std::ifstream ifs(fileName.c_str(), std::ios::binary);
+	if (!ifs) {
+		std::cout << "I cannot open " << fileName << std::endl;
+		return;
+	}
+	std::string header;
+	std::string line;
+	std::map<Key, std::vector<BookEntry> > bookMap;
+
+	while (std::getline(ifs, header)) {
+		if (!std::getline(ifs, line)) {
+			std::cout << "!!! header only !!!" << std::endl;
+			return;
+		}
+		replayKifu(pos, header, line, [&](const Position& pos, const Key key, const Move move) {
+			bool isFind = false;
+			if (bookMap.find(key) != bookMap.end()) {
+				for (std::vector<BookEntry>::iterator it = bookMap[key].begin();
+					 it != bookMap[key].end();
+					 ++it)
+				{
+					if (it->fromToPro == move.proFromAndTo()) {
+						++it->count;
+						if (it->count < 1)
+							--it->count; // 数えられる数の上限を超えたので元に戻す。
+						isFind = true;
 					}
 				}
-				if (isFind == false) {
+			}
+			if (isFind == false) {
 #if defined MAKE_SEARCHED_BOOK
-					SetUpStates->push(StateInfo());
-					pos.doMove(move, SetUpStates->top());
-
-					std::istringstream ssCmd("byoyomi 1000");
-					go(pos, ssCmd);
-					Threads.main()->wait_for_search_finished();
-
-					pos.undoMove(move);
-					SetUpStates->pop();
-
-					// doMove してから search してるので点数が反転しているので直す。
-                    const Score score = -pos.thisThread()->rootMoves[0].score;
-#else
-					const Score score = ScoreZero;
+				sfens.emplace(key, pos.toSFEN());
 #endif
-					// 未登録の手
-					BookEntry be;
-					be.score = score;
-					be.key = key;
-					be.fromToPro = static_cast<u16>(move.proFromAndTo());
-					be.count = 1;
-					bookMap[key].push_back(be);
-				}
+				// 未登録の手
+				BookEntry be;
+				be.score = ScoreZero;
+				be.key = key;
+				be.fromToPro = static_cast<u16>(move.proFromAndTo());
+				be.count = 1;
+				bookMap[key].push_back(be);
 			}
-			SetUpStates->push(StateInfo());
-			pos.doMove(move, SetUpStates->top());
-		}
+		});
 	}
 
+#if defined MAKE_SEARCHED_BOOK
+	if (!scoreBook(pos, bookMap, sfens, scoreOpt))
+		return;
+#endif
+
 	// BookEntry::count の値で降順にソート
 	for (auto& elem : bookMap) {
 		std::sort(elem.second.rbegin(), elem.second.rend(), countCompare);
@@ -271,4 +442,191 @@ void makeBook(Position& pos, std::istringstream& ssCmd) {
 
 	std::cout << "book making was done" << std::endl;
 }
+
+namespace {
+	// (key, fromToPro) の順。定跡ファイル内の並びとは違い、run ファイルと merge はこの順で扱う。
+	inline bool entryKeyLess(const BookEntry& lhs, const BookEntry& rhs) {
+		return lhs.key < rhs.key || (lhs.key == rhs.key && lhs.fromToPro < rhs.fromToPro);
+	}
+
+	inline void addCount(BookEntry& dst, const BookEntry& src) {
+		dst.count = static_cast<u16>(std::min<u32>(static_cast<u32>(dst.count) + src.count, std::numeric_limits<u16>::max()));
+	}
+
+	// 棋譜を複数のスレッドで分担する為に、ファイルを順に開いて games 局ずつ渡す。
+	class KifuReader {
+	public:
+		explicit KifuReader(const std::vector<std::string>& fileNames) : fileNames_(fileNames) {}
+		// 読み終わったら false
+		bool read(std::vector<std::pair<std::string, std::string> >& games, const size_t num) {
+			std::unique_lock<Mutex> lock(mutex_);
+			games.clear();
+			std::string header;
+			std::string line;
+			while (games.size() < num) {
+				if (!ifs_.is_open() || !std::getline(ifs_, header)) {
+					if (fileIndex_ == fileNames_.size())
+						break;
+					ifs_.close();
+					ifs_.clear();
+					ifs_.open(fileNames_[fileIndex_++].c_str(), std::ios::binary);
+					if (!ifs_)
+						std::cout << "I cannot open " << fileNames_[fileIndex_ - 1] << std::endl;
+					continue;
+				}
+				if (!std::getline(ifs_, line)) {
+					std::cout << "!!! header only !!!" << std::endl;
+					break;
+				}
+				games.emplace_back(header, line);
+			}
+			return !games.empty();
+		}
+
+	private:
+		Mutex mutex_;
+		const std::vector<std::string>& fileNames_;
+		size_t fileIndex_ = 0;
+		std::ifstream ifs_;
+	};
+
+	// run ファイルを少しずつ読む。
+	class RunReader {
+	public:
+		explicit RunReader(const std::string& fileName) : ifs_(fileName.c_str(), std::ios::binary), buf_(4096) { fill(); }
+		bool empty() const { return pos_ == size_; }
+		const BookEntry& front() const { return buf_[pos_]; }
+		void pop() {
+			if (++pos_ == size_)
+				fill();
+		}
+
+	private:
+		void fill() {
+			ifs_.read(reinterpret_cast<char*>(buf_.data()), buf_.size() * sizeof(BookEntry));
+			size_ = ifs_.gcount() / sizeof(BookEntry);
+			pos_ = 0;
+		}
+
+		std::ifstream ifs_;
+		std::vector<BookEntry> buf_;
+		size_t size_ = 0;
+		size_t pos_ = 0;
+	};
+}
+
+// 大量の棋譜から、メモリを一定量しか使わずに定跡を作る。
+// 各スレッドは棋譜を再生して (key, 指し手, 出現回数) を溜め、一定数溜まったら
+// (key, 指し手) の順に並べて同じものをまとめ、run ファイルに書き出す。
+// 最後に全ての run ファイルを同時に順に読んで merge し、book.bin を書き出す。
+// 点数は付けないので、探索で点数を付ける場合は b を使うこと。
+// bx <棋譜ファイル>... [threads <num>] [run <entries>] [tmp <prefix>]
+void makeBookExternal(std::istringstream& ssCmd) {
+	std::vector<std::string> fileNames;
+	size_t threadNum = std::max(1u, std::thread::hardware_concurrency());
+	size_t runEntries = 1 << 22; // 1 スレッドが 1 つの run ファイルを書くまでに溜める数。64MB
+	std::string tmpPrefix = "book_run";
+	std::string token;
+	while (ssCmd >> token) {
+		if      (token == "threads") ssCmd >> threadNum;
+		else if (token == "run"    ) ssCmd >> runEntries;
+		else if (token == "tmp"    ) ssCmd >> tmpPrefix;
+		else                         fileNames.push_back(token);
+	}
+	if (fileNames.empty() || threadNum == 0 || runEntries == 0) {
+		std::cout << "usage: bx <kifu>... [threads <num>] [run <entries>] [tmp <prefix>]" << std::endl;
+		return;
+	}
+
+	const auto runFileName = [&](const size_t i) { return tmpPrefix + "_" + std::to_string(i) + ".bin"; };
+	KifuReader reader(fileNames);
+	std::atomic<size_t> runNum(0);
+	std::atomic<u64> gameNum(0);
+
+	const auto writeRun = [&](std::vector<BookEntry>& entries) {
+		std::sort(entries.begin(), entries.end(), entryKeyLess);
+		std::ofstream ofs(runFileName(runNum++).c_str(), std::ios::binary);
+		for (size_t i = 0; i < entries.size(); ) {
+			BookEntry be = entries[i];
+			while (++i < entries.size() && !entryKeyLess(be, entries[i]))
+				addCount(be, entries[i]);
+			ofs.write(reinterpret_cast<const char*>(&be), sizeof(BookEntry));
+		}
+		entries.clear();
+	};
+
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < threadNum; ++t) {
+		threads.emplace_back([&] {
+			auto pos = std::unique_ptr<Position>(new Position);
+			std::vector<std::pair<std::string, std::string> > games;
+			std::vector<BookEntry> entries;
+			entries.reserve(runEntries);
+			while (reader.read(games, 1024)) {
+				for (const auto& game : games) {
+					replayKifu(*pos, game.first, game.second, [&](const Position&, const Key key, const Move move) {
+						BookEntry be;
+						be.key = key;
+						be.fromToPro = static_cast<u16>(move.proFromAndTo());
+						be.count = 1;
+						be.score = ScoreZero;
+						entries.push_back(be);
+						if (entries.size() == runEntries)
+							writeRun(entries);
+					});
+				}
+				gameNum += games.size();
+			}
+			if (!entries.empty())
+				writeRun(entries);
+		});
+	}
+	for (std::thread& th : threads)
+		th.join();
+	std::cout << "games: " << gameNum << ", runs: " << runNum << std::endl;
+
+	// merge。同じ key の指し手だけをメモリに置き、出現回数の降順に並べて書き出す。
+	std::vector<std::unique_ptr<RunReader> > runs;
+	for (size_t i = 0; i < runNum; ++i)
+		runs.emplace_back(new RunReader(runFileName(i)));
+	const auto greater = [&](const size_t lhs, const size_t rhs) { return entryKeyLess(runs[rhs]->front(), runs[lhs]->front()); };
+	std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> queue(greater);
+	for (size_t i = 0; i < runs.size(); ++i) {
+		if (!runs[i]->empty())
+			queue.push(i);
+	}
+
+	std::ofstream ofs("book.bin", std::ios::binary);
+	std::vector<BookEntry> sameKey;
+	u64 entryNum = 0;
+	const auto flush = [&] {
+		std::stable_sort(sameKey.rbegin(), sameKey.rend(), countCompare);
+		ofs.write(reinterpret_cast<const char*>(sameKey.data()), sameKey.size() * sizeof(BookEntry));
+		entryNum += sameKey.size();
+		sameKey.clear();
+	};
+	while (!queue.empty()) {
+		const size_t i = queue.top();
+		queue.pop();
+		const BookEntry be = runs[i]->front();
+		runs[i]->pop();
+		if (!runs[i]->empty())
+			queue.push(i);
+
+		if (!sameKey.empty() && sameKey.back().key != be.key)
+			flush();
+		if (!sameKey.empty() && sameKey.back().fromToPro == be.fromToPro)
+			addCount(sameKey.back(), be);
+		else
+			sameKey.push_back(be);
+	}
+	flush();
+
+	runs.clear();
+	for (size_t i = 0; i < runNum; ++i)
+		std::remove(runFileName(i).c_str());
+
+	std::cout << "book entries: " << entryNum << std::endl;
+	std::cout << "book making was done" << std::endl;
+}
 #endif
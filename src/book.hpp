@@ -11,21 +11,33 @@ struct BookEntry {
 	Score score;
 };
 
-class Book : private std::ifstream {
+// 定跡ファイルは key の昇順に並んだ BookEntry の配列。
+// 読み込み専用で mmap し、key の上位 IndexBits ビットごとの開始位置を索引として持つ。
+// probe ではシステムコールを呼ばず、同じファイルを開いた複数のプロセスでページを共有できる。
+class Book {
 public:
 	Book() : random_(std::chrono::system_clock::now().time_since_epoch().count()) {}
+	~Book() { close(); }
+	Book(const Book&) = delete;
+	Book& operator=(const Book&) = delete;
 	std::tuple<Move, Score> probe(const Position& pos, const std::string& fName, const bool pickBest);
 	static void init();
 	static Key bookKey(const Position& pos);
 
 private:
+	static const int IndexBits = 16;
+
 	bool open(const char* fName);
-	void binary_search(const Key key);
+	void close();
+	const BookEntry* lower_bound(const Key key) const;
 
 	static MT64bit mt64bit_; // 定跡のhash生成用なので、seedは固定でデフォルト値を使う。
 	MT64bit random_; // 時刻をseedにして色々指すようにする。
 	std::string fileName_;
-	size_t size_;
+	const BookEntry* entries_ = nullptr;
+	size_t size_ = 0;
+	size_t mappedSize_ = 0;
+	std::vector<size_t> index_; // index_[k >> (64 - IndexBits)] 以降に key >= k の最初の要素がある。
 
 	static Key ZobPiece[PieceNone][SquareNum];
 	static Key ZobHand[HandPieceNum][19];
@@ -33,5 +45,6 @@ private:
 };
 
 void makeBook(Position& pos, std::istringstream& ssCmd);
+void makeBookExternal(std::istringstream& ssCmd);
 
 #endif // #ifndef APERY_BOOK_HPP
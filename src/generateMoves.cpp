@@ -5,9 +5,9 @@ namespace {
 	// 角, 飛車の場合
 	template <MoveType MT, PieceType PT, Color US, bool ALL>
 	FORCE_INLINE ExtMove* generateBishopOrRookMoves(ExtMove* moveList, const Position& pos,
-													  const Bitboard& target, const Square /*ksq*/)
+													  const Bitboard& target, const Square /*ksq*/, const Bitboard& fromMask)
 	{
-		Bitboard fromBB = pos.bbOf(PT, US);
+		Bitboard fromBB = pos.bbOf(PT, US) & fromMask;
 		while (fromBB) {
 			const Square from = fromBB.firstOneFromSQ11();
 			const bool fromCanPromote = canPromote(US, makeRank(from));
@@ -27,6 +27,58 @@ namespace {
 		return moveList;
 	}
 
+#if defined USE_SIMD_DROP_MOVES
+	// 歩以外の駒打ちの書き込み
+	// 打つ駒の種類ごとに移動先が SQ11 の指し手を並べておき、移動先を足して 1 マス分の指し手をまとめて書き込む。
+	// ExtMove は 8 byte なので __m256i 1 つに 4 手入る。歩以外の持ち駒は最大 6 種類なので 2 つ使う。
+	// score も 0 で上書きする。MaxLegalMoves の配列の末尾を越えないように、端数は maskstore で必要な分だけ書く。
+	// 持ち駒の種類の組み合わせ (桂, 香, 銀, 金, 角, 飛 の順の 6 bit) ごとに、予め作っておく。
+	struct DropMoveSet {
+		__m256i moves[2];
+		__m256i mask; // 端数の方の moves[] に対する mask
+		int num;
+
+		FORCE_INLINE ExtMove* write(ExtMove* moveList, const Square to) const {
+			static_assert(sizeof(ExtMove) == sizeof(s64), "");
+			const __m256i toVec = _mm256_set1_epi64x(to);
+			if (4 <= num) {
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(moveList), _mm256_add_epi64(moves[0], toVec));
+				if (4 < num)
+					_mm256_maskstore_epi64(reinterpret_cast<long long*>(moveList + 4), mask, _mm256_add_epi64(moves[1], toVec));
+			}
+			else
+				_mm256_maskstore_epi64(reinterpret_cast<long long*>(moveList), mask, _mm256_add_epi64(moves[0], toVec));
+			return moveList + num;
+		}
+	};
+	const int DropKnightBit = 1;
+	const int DropLanceBit  = 2;
+	struct DropMoveTable {
+		DropMoveSet sets[1 << 6];
+
+		DropMoveTable() {
+			const PieceType pts[6] = {Knight, Lance, Silver, Gold, Bishop, Rook};
+			for (int handSet = 0; handSet < (1 << 6); ++handSet) {
+				alignas(32) s64 m[8] = {};
+				int num = 0;
+				for (int i = 0; i < 6; ++i) {
+					if (handSet & (1 << i))
+						m[num++] = makeDropMove(pts[i], SQ11).value();
+				}
+				alignas(32) s64 k[4] = {};
+				for (int i = (num < 4 ? 0 : 4); i < num; ++i)
+					k[i & 3] = -1;
+				DropMoveSet& set = sets[handSet];
+				set.moves[0] = _mm256_load_si256(reinterpret_cast<const __m256i*>(m + 0));
+				set.moves[1] = _mm256_load_si256(reinterpret_cast<const __m256i*>(m + 4));
+				set.mask = _mm256_load_si256(reinterpret_cast<const __m256i*>(k));
+				set.num = num;
+			}
+		}
+	};
+	const DropMoveTable DropMoves;
+#endif
+
 	// 駒打ちの場合
 	// 歩以外の持ち駒は、loop の前に持ち駒の種類の数によって switch で展開している。
 	// ループの展開はコードが膨れ上がる事によるキャッシュヒット率の低下と、演算回数のバランスを取って決める必要がある。
@@ -92,6 +144,37 @@ namespace {
 			const Bitboard TRank2BB = rankMask<TRank2>();
 			const Bitboard TRank1BB = rankMask<TRank1>();
 
+#if defined USE_SIMD_DROP_MOVES
+			// 持ち駒の種類が多いときは、1 マス分の指し手をまとめて書き込む。
+			// 種類が少ないときは Unroller で展開した方が速い。
+			if (4 <= haveHandNum) {
+				const int handSet =
+					(hand.exists<HKnight>() ? DropKnightBit : 0) | (hand.exists<HLance >() ? DropLanceBit : 0)
+					| (hand.exists<HSilver>() ? 4 : 0) | (hand.exists<HGold  >() ? 8 : 0)
+					| (hand.exists<HBishop>() ? 16 : 0) | (hand.exists<HRook  >() ? 32 : 0);
+				const DropMoveSet& dropAll             = DropMoves.sets[handSet];
+				const DropMoveSet& dropNoKnight        = DropMoves.sets[handSet & ~DropKnightBit];
+				const DropMoveSet& dropNoKnightLance   = DropMoves.sets[handSet & ~(DropKnightBit | DropLanceBit)];
+
+				Bitboard toBB;
+				Square to;
+				// 一段目に対して、桂馬、香車以外の指し手を生成。
+				if (dropNoKnightLance.num) {
+					toBB = target & TRank1BB;
+					FOREACH_BB(toBB, to, { moveList = dropNoKnightLance.write(moveList, to); });
+				}
+				// 二段目に対して、桂馬以外の指し手を生成。
+				if (dropNoKnight.num) {
+					toBB = target & TRank2BB;
+					FOREACH_BB(toBB, to, { moveList = dropNoKnight.write(moveList, to); });
+				}
+				// 一、二段目以外に対して、全ての持ち駒の指し手を生成。
+				toBB = target & ~(TRank2BB | TRank1BB);
+				FOREACH_BB(toBB, to, { moveList = dropAll.write(moveList, to); });
+				return moveList;
+			}
+#endif
+
 			Bitboard toBB;
 			Square to;
 			// 桂馬、香車 以外の持ち駒があれば、
@@ -136,10 +219,11 @@ namespace {
 
 	// 金, 成り金、馬、竜の指し手生成
 	template <MoveType MT, PieceType PT, Color US, bool ALL> struct GeneratePieceMoves {
-		FORCE_INLINE ExtMove* operator () (ExtMove* moveList, const Position& pos, const Bitboard& target, const Square /*ksq*/) {
+		FORCE_INLINE ExtMove* operator () (ExtMove* moveList, const Position& pos, const Bitboard& target, const Square /*ksq*/,
+											   const Bitboard& fromMask = allOneBB()) {
 			static_assert(PT == GoldHorseDragon, "");
 			// 金、成金、馬、竜のbitboardをまとめて扱う。
-			Bitboard fromBB = (pos.goldsBB() | pos.bbOf(Horse, Dragon)) & pos.bbOf(US);
+			Bitboard fromBB = (pos.goldsBB() | pos.bbOf(Horse, Dragon)) & pos.bbOf(US) & fromMask;
 			while (fromBB) {
 				const Square from = fromBB.firstOneFromSQ11();
 				// from にある駒の種類を判別
@@ -155,13 +239,14 @@ namespace {
 	};
 	// 歩の場合
 	template <MoveType MT, Color US, bool ALL> struct GeneratePieceMoves<MT, Pawn, US, ALL> {
-		FORCE_INLINE ExtMove* operator () (ExtMove* moveList, const Position& pos, const Bitboard& target, const Square /*ksq*/) {
+		FORCE_INLINE ExtMove* operator () (ExtMove* moveList, const Position& pos, const Bitboard& target, const Square /*ksq*/,
+											   const Bitboard& fromMask = allOneBB()) {
 			// Txxx は先手、後手の情報を吸収した変数。数字は先手に合わせている。
 			const Rank TRank4 = (US == Black ? Rank4 : Rank6);
 			const Bitboard TRank123BB = inFrontMask<US, TRank4>();
 			const SquareDelta TDeltaS = (US == Black ? DeltaS : DeltaN);
 
-			Bitboard toBB = pawnAttack<US>(pos.bbOf(Pawn, US)) & target;
+			Bitboard toBB = pawnAttack<US>(pos.bbOf(Pawn, US) & fromMask) & target;
 
 			// 成り
 			if (MT != NonCaptureMinusPro) {
@@ -195,8 +280,9 @@ namespace {
 	};
 	// 香車の場合
 	template <MoveType MT, Color US, bool ALL> struct GeneratePieceMoves<MT, Lance, US, ALL> {
-		FORCE_INLINE ExtMove* operator () (ExtMove* moveList, const Position& pos, const Bitboard& target, const Square /*ksq*/) {
-			Bitboard fromBB = pos.bbOf(Lance, US);
+		FORCE_INLINE ExtMove* operator () (ExtMove* moveList, const Position& pos, const Bitboard& target, const Square /*ksq*/,
+											   const Bitboard& fromMask = allOneBB()) {
+			Bitboard fromBB = pos.bbOf(Lance, US) & fromMask;
 			while (fromBB) {
 				const Square from = fromBB.firstOneFromSQ11();
 				Bitboard toBB = pos.attacksFrom<Lance>(US, from) & target;
@@ -227,8 +313,9 @@ namespace {
 	};
 	// 桂馬の場合
 	template <MoveType MT, Color US, bool ALL> struct GeneratePieceMoves<MT, Knight, US, ALL> {
-		FORCE_INLINE ExtMove* operator () (ExtMove* moveList, const Position& pos, const Bitboard& target, const Square /*ksq*/) {
-			Bitboard fromBB = pos.bbOf(Knight, US);
+		FORCE_INLINE ExtMove* operator () (ExtMove* moveList, const Position& pos, const Bitboard& target, const Square /*ksq*/,
+											   const Bitboard& fromMask = allOneBB()) {
+			Bitboard fromBB = pos.bbOf(Knight, US) & fromMask;
 			while (fromBB) {
 				const Square from = fromBB.firstOneFromSQ11();
 				Bitboard toBB = pos.attacksFrom<Knight>(US, from) & target;
@@ -249,8 +336,9 @@ namespace {
 	};
 	// 銀の場合
 	template <MoveType MT, Color US, bool ALL> struct GeneratePieceMoves<MT, Silver, US, ALL> {
-		FORCE_INLINE ExtMove* operator () (ExtMove* moveList, const Position& pos, const Bitboard& target, const Square /*ksq*/) {
-			Bitboard fromBB = pos.bbOf(Silver, US);
+		FORCE_INLINE ExtMove* operator () (ExtMove* moveList, const Position& pos, const Bitboard& target, const Square /*ksq*/,
+											   const Bitboard& fromMask = allOneBB()) {
+			Bitboard fromBB = pos.bbOf(Silver, US) & fromMask;
 			while (fromBB) {
 				const Square from = fromBB.firstOneFromSQ11();
 				const bool fromCanPromote = canPromote(US, makeRank(from));
@@ -267,13 +355,15 @@ namespace {
 		}
 	};
 	template <MoveType MT, Color US, bool ALL> struct GeneratePieceMoves<MT, Bishop, US, ALL> {
-		FORCE_INLINE ExtMove* operator () (ExtMove* moveList, const Position& pos, const Bitboard& target, const Square ksq) {
-			return generateBishopOrRookMoves<MT, Bishop, US, ALL>(moveList, pos, target, ksq);
+		FORCE_INLINE ExtMove* operator () (ExtMove* moveList, const Position& pos, const Bitboard& target, const Square ksq,
+										   const Bitboard& fromMask = allOneBB()) {
+			return generateBishopOrRookMoves<MT, Bishop, US, ALL>(moveList, pos, target, ksq, fromMask);
 		}
 	};
 	template <MoveType MT, Color US, bool ALL> struct GeneratePieceMoves<MT, Rook, US, ALL> {
-		FORCE_INLINE ExtMove* operator () (ExtMove* moveList, const Position& pos, const Bitboard& target, const Square ksq) {
-			return generateBishopOrRookMoves<MT, Rook, US, ALL>(moveList, pos, target, ksq);
+		FORCE_INLINE ExtMove* operator () (ExtMove* moveList, const Position& pos, const Bitboard& target, const Square ksq,
+										   const Bitboard& fromMask = allOneBB()) {
+			return generateBishopOrRookMoves<MT, Rook, US, ALL>(moveList, pos, target, ksq, fromMask);
 		}
 	};
 	// 玉の場合
@@ -418,63 +508,73 @@ namespace {
 		}
 	}
 
-	// 部分特殊化
 	// 王手回避生成
 	// 王手をしている駒による王手は避けるが、
-	// 玉の移動先に敵の利きがある場合と、pinされている味方の駒を動かした場合、非合法手を生成する。
+	// LEGAL == false のときは、玉の移動先に敵の利きがある場合と、pinされている味方の駒を動かした場合、非合法手を生成する。
 	// そのため、pseudo legal である。
-	template <Color US, bool ALL> struct GenerateMoves<Evasion, US, ALL> {
-		/*FORCE_INLINE*/ ExtMove* operator () (ExtMove* moveList, const Position& pos) {
-			assert(pos.isOK());
-			assert(pos.inCheck());
-
-			const Square ksq = pos.kingSquare(US);
-			const Color Them = oppositeColor(US);
-			const Bitboard checkers = pos.checkersBB();
-			Bitboard bb = checkers;
-			Bitboard bannedKingToBB = allZeroBB();
-			int checkersNum = 0;
-			Square checkSq;
-
-			// 玉が逃げられない位置の bitboard を生成する。
-			// 絶対に王手が掛かっているので、while ではなく、do while
-			do {
-				checkSq = bb.firstOneFromSQ11();
-				assert(pieceToColor(pos.piece(checkSq)) == Them);
-				++checkersNum;
-				makeBannedKingTo<Them>(bannedKingToBB, pos, checkSq, ksq);
-			} while (bb);
-
-			// 玉が移動出来る移動先を格納。
-			bb = bannedKingToBB.notThisAnd(pos.bbOf(US).notThisAnd(kingAttack(ksq)));
-			while (bb) {
-				const Square to = bb.firstOneFromSQ11();
-				// 移動先に相手駒の利きがあるか調べずに指し手を生成する。
-				// attackersTo() が重いので、movePicker か search で合法手か調べる。
+	// LEGAL == true のときは、玉の移動先の利きを調べ、pin されている駒は動かさない。
+	// (pin されている駒は王手している駒を取ることも、合駒することも出来ない。)
+	template <Color US, bool ALL, bool LEGAL>
+	FORCE_INLINE ExtMove* generateEvasionMoves(ExtMove* moveList, const Position& pos) {
+		assert(pos.isOK());
+		assert(pos.inCheck());
+
+		const Square ksq = pos.kingSquare(US);
+		const Color Them = oppositeColor(US);
+		const Bitboard checkers = pos.checkersBB();
+		Bitboard bb = checkers;
+		Bitboard bannedKingToBB = allZeroBB();
+		int checkersNum = 0;
+		Square checkSq;
+
+		// 玉が逃げられない位置の bitboard を生成する。
+		// 絶対に王手が掛かっているので、while ではなく、do while
+		do {
+			checkSq = bb.firstOneFromSQ11();
+			assert(pieceToColor(pos.piece(checkSq)) == Them);
+			++checkersNum;
+			makeBannedKingTo<Them>(bannedKingToBB, pos, checkSq, ksq);
+		} while (bb);
+
+		// 玉が移動出来る移動先を格納。
+		bb = bannedKingToBB.notThisAnd(pos.bbOf(US).notThisAnd(kingAttack(ksq)));
+		while (bb) {
+			const Square to = bb.firstOneFromSQ11();
+			// LEGAL == false のときは、移動先に相手駒の利きがあるか調べずに指し手を生成する。
+			// attackersTo() が重いので、movePicker か search で合法手か調べる。
+			if (!LEGAL || !pos.attackersToIsAny(Them, to))
 				(*moveList++).move = makeNonPromoteMove<Capture>(King, ksq, to, pos);
-			}
+		}
 
-			// 両王手なら、玉を移動するしか回避方法は無い。
-			// 玉の移動は生成したので、ここで終了
-			if (1 < checkersNum)
-				return moveList;
+		// 両王手なら、玉を移動するしか回避方法は無い。
+		// 玉の移動は生成したので、ここで終了
+		if (1 < checkersNum)
+			return moveList;
 
-			// 王手している駒を玉以外で取る手の生成。
-			// pin されているかどうかは movePicker か search で調べる。
-			const Bitboard target1 = betweenBB(checkSq, ksq);
-			const Bitboard target2 = target1 | checkers;
-			moveList = GeneratePieceMoves<Evasion, Pawn,   US, ALL>()(moveList, pos, target2, ksq);
-			moveList = GeneratePieceMoves<Evasion, Lance,  US, ALL>()(moveList, pos, target2, ksq);
-			moveList = GeneratePieceMoves<Evasion, Knight, US, ALL>()(moveList, pos, target2, ksq);
-			moveList = GeneratePieceMoves<Evasion, Silver, US, ALL>()(moveList, pos, target2, ksq);
-			moveList = GeneratePieceMoves<Evasion, Bishop, US, ALL>()(moveList, pos, target2, ksq);
-			moveList = GeneratePieceMoves<Evasion, Rook,   US, ALL>()(moveList, pos, target2, ksq);
-			moveList = GeneratePieceMoves<Evasion, GoldHorseDragon,   US, ALL>()(moveList, pos, target2, ksq);
-
-			if (target1)
-				moveList = generateDropMoves<US>(moveList, pos, target1);
+		// 王手している駒を玉以外で取る手の生成。
+		// LEGAL == false のときは、pin されているかどうかは movePicker か search で調べる。
+		const Bitboard target1 = betweenBB(checkSq, ksq);
+		const Bitboard target2 = target1 | checkers;
+		const Bitboard fromMask = (LEGAL ? ~pos.pinnedBB() : allOneBB());
+		moveList = GeneratePieceMoves<Evasion, Pawn,   US, ALL>()(moveList, pos, target2, ksq, fromMask);
+		moveList = GeneratePieceMoves<Evasion, Lance,  US, ALL>()(moveList, pos, target2, ksq, fromMask);
+		moveList = GeneratePieceMoves<Evasion, Knight, US, ALL>()(moveList, pos, target2, ksq, fromMask);
+		moveList = GeneratePieceMoves<Evasion, Silver, US, ALL>()(moveList, pos, target2, ksq, fromMask);
+		moveList = GeneratePieceMoves<Evasion, Bishop, US, ALL>()(moveList, pos, target2, ksq, fromMask);
+		moveList = GeneratePieceMoves<Evasion, Rook,   US, ALL>()(moveList, pos, target2, ksq, fromMask);
+		moveList = GeneratePieceMoves<Evasion, GoldHorseDragon,   US, ALL>()(moveList, pos, target2, ksq, fromMask);
+
+		if (target1)
+			moveList = generateDropMoves<US>(moveList, pos, target1);
 
-			return moveList;
+		return moveList;
+	}
+
+	// 部分特殊化
+	// 王手回避生成 (pseudo legal)
+	template <Color US, bool ALL> struct GenerateMoves<Evasion, US, ALL> {
+		/*FORCE_INLINE*/ ExtMove* operator () (ExtMove* moveList, const Position& pos) {
+			return generateEvasionMoves<US, ALL, false>(moveList, pos);
 		}
 	};
 
@@ -503,26 +603,197 @@ namespace {
 		}
 	};
 
+	// 成れる移動で、成る手に加えて不成も生成するか。
+	// ALL == true のときは NonEvasion と同じく、歩、飛、角の不成と、香の二段目、三段目の不成も生成する。
+	template <Color US, bool ALL>
+	FORCE_INLINE bool generateNonPromoteToo(const PieceType pt, const Square to) {
+		switch (pt) {
+		case Pawn  : case Lance: return ALL && isBehind<US, Rank1, Rank9>(makeRank(to)); // 一段目の不成は省く
+		case Knight: return isBehind<US, Rank2, Rank8>(makeRank(to)); // 一, 二段目の不成は省く
+		case Silver: return true;
+		case Bishop: case Rook: return ALL;
+		default    : UNREACHABLE; return false;
+		}
+	}
+
+	// from にある駒を動かす王手の生成
+	// 直接王手は checkBB、開き王手は dcBB から判定するので、moveGivesCheck() で全ての指し手を調べるより速い。
+	template <MoveType MT, Color US, bool ALL>
+	FORCE_INLINE ExtMove* generateCheckMovesFrom(ExtMove* moveList, const Position& pos, const CheckInfo& ci,
+												 const PieceType pt, const Square from, const Bitboard& target, const Square ksq)
+	{
+		const bool fromIsDC = ci.dcBB.isSet(from);
+		const bool promotable = (pt < Gold);
+		const PieceType ptPro = (promotable ? pt + PTPromote : pt);
+		Bitboard toBB = pos.attacksFrom(pt, US, from) & target;
+		// 開き王手にならない駒は、直接王手になる位置だけを調べれば良い。
+		if (!fromIsDC)
+			toBB &= (promotable ? ci.checkBB[pt] | ci.checkBB[ptPro] : ci.checkBB[pt]);
+
+		while (toBB) {
+			const Square to = toBB.firstOneFromSQ11();
+			// 桂馬ならどこに動いても開き王手になる。
+			const bool discovered = fromIsDC && (pt == Knight || !isAligned<true>(from, to, ksq));
+			if (promotable && (canPromote(US, makeRank(from)) | canPromote(US, makeRank(to)))) {
+				// 歩の駒を取らない成りは CapturePlusPro で生成するので、QuietCheck では生成しない。
+				if (!(MT == QuietCheck && pt == Pawn)
+					&& (discovered || ci.checkBB[ptPro].isSet(to)))
+				{
+					(*moveList++).move = makePromoteMove<MT>(pt, from, to, pos);
+				}
+				if ((discovered || ci.checkBB[pt].isSet(to))
+					&& generateNonPromoteToo<US, ALL>(pt, to))
+				{
+					(*moveList++).move = makeNonPromoteMove<MT>(pt, from, to, pos);
+				}
+			}
+			else if (discovered || ci.checkBB[pt].isSet(to))
+				(*moveList++).move = makeNonPromoteMove<MT>(pt, from, to, pos);
+		}
+		return moveList;
+	}
+
+	// 駒打ちによる王手の生成
+	// 駒を打てない段に王手になる位置は無いので、段の制限は調べなくて良い。
+	template <Color US>
+	FORCE_INLINE ExtMove* generateCheckDropMoves(ExtMove* moveList, const Position& pos, const CheckInfo& ci) {
+		const Hand hand = pos.hand(US);
+		const Bitboard empty = pos.emptyBB();
+
+		// 歩は玉の正面にしか王手出来ない。二歩と打ち歩詰めを回避する。
+		if (hand.exists<HPawn>()) {
+			const Bitboard toBB = ci.checkBB[Pawn] & empty;
+			if (toBB) {
+				const Square to = toBB.constFirstOneFromSQ11();
+				if (!pos.bbOf(Pawn, US).andIsAny(squareFileMask(to))
+					&& !pos.isPawnDropCheckMate(US, to))
+				{
+					(*moveList++).move = makeDropMove(Pawn, to);
+				}
+			}
+		}
+
+		auto dropTo = [&](const PieceType pt) {
+			Bitboard toBB = ci.checkBB[pt] & empty;
+			Square to;
+			FOREACH_BB(toBB, to, {
+					(*moveList++).move = makeDropMove(pt, to);
+				});
+		};
+		if (hand.exists<HLance >()) dropTo(Lance );
+		if (hand.exists<HKnight>()) dropTo(Knight);
+		if (hand.exists<HSilver>()) dropTo(Silver);
+		if (hand.exists<HGold  >()) dropTo(Gold  );
+		if (hand.exists<HBishop>()) dropTo(Bishop);
+		if (hand.exists<HRook  >()) dropTo(Rook  );
+
+		return moveList;
+	}
+
+	// 王手生成
+	// 玉の移動による自殺手と、pin されている駒の移動による自殺手を含むので pseudo legal
+	template <MoveType MT, Color US, bool ALL>
+	FORCE_INLINE ExtMove* generateCheckMoves(ExtMove* moveList, const Position& pos, const Bitboard& target) {
+		assert(!pos.inCheck());
+
+		const CheckInfo ci(pos);
+		const Square ksq = pos.kingSquare(oppositeColor(US));
+
+		moveList = generateCheckDropMoves<US>(moveList, pos, ci);
+
+		Bitboard fromBB = pos.bbOf(US);
+		while (fromBB) {
+			const Square from = fromBB.firstOneFromSQ11();
+			moveList = generateCheckMovesFrom<MT, US, ALL>(moveList, pos, ci, pieceToPieceType(pos.piece(from)), from, target, ksq);
+		}
+		return moveList;
+	}
+
+	// 部分特殊化
+	// 王手が掛かっていないときの王手生成
+	template <Color US> struct GenerateMoves<Check, US> {
+		ExtMove* operator () (ExtMove* moveList, const Position& pos) {
+			return generateCheckMoves<Check, US, true>(moveList, pos, ~pos.bbOf(US));
+		}
+	};
+
 	// 部分特殊化
+	// 駒を取らない王手の生成。静止探索で駒を取る手の後に使う。
+	template <Color US> struct GenerateMoves<QuietCheck, US> {
+		ExtMove* operator () (ExtMove* moveList, const Position& pos) {
+			return generateCheckMoves<QuietCheck, US, false>(moveList, pos, pos.emptyBB());
+		}
+	};
+
+	// pin されている from の駒が動ける位置。玉と from を結ぶ直線上 (pin している駒を含む) だけに動ける。
+	// 玉の向こう側の位置も含むが、玉を越えては動けないので target と利きの & を取れば問題無い。
+	inline Bitboard pinLineBB(const Square from, const Square ksq) {
+		return (squareRelation(from, ksq) & DirecDiag) ?
+			bishopAttackToEdge(ksq) & bishopAttackToEdge(from) :
+			rookAttackToEdge(ksq) & rookAttackToEdge(from);
+	}
+
 	// 連続王手の千日手以外の反則手を排除した合法手生成
-	// そんなに速度が要求されるところでは呼ばない。
-	template <Color US> struct GenerateMoves<Legal, US> {
-		FORCE_INLINE ExtMove* operator () (ExtMove* moveList, const Position& pos) {
-			ExtMove* curr = moveList;
-			const Bitboard pinned = pos.pinnedBB();
-
-			moveList = pos.inCheck() ?
-				GenerateMoves<Evasion, US>()(moveList, pos) : GenerateMoves<NonEvasion, US>()(moveList, pos);
-
-			// 玉の移動による自殺手と、pinされている駒の移動による自殺手を削除
-			while (curr != moveList) {
-				if (!pos.pseudoLegalMoveIsLegal<false, false>(curr->move, pinned))
-					curr->move = (--moveList)->move;
-				else
-					++curr;
+	// 生成した後で 1 手ずつ合法か調べるのではなく、
+	// pin されている駒は pin の直線上だけ、玉は相手の利きの無い位置だけに動かすことで、最初から合法手だけを生成する。
+	// 打ち歩詰めは generateDropMoves() で排除している。
+	template <Color US, bool ALL>
+	FORCE_INLINE ExtMove* generateLegalMoves(ExtMove* moveList, const Position& pos) {
+		if (pos.inCheck())
+			return generateEvasionMoves<US, ALL, true>(moveList, pos);
+
+		const Color Them = oppositeColor(US);
+		Bitboard target = pos.emptyBB();
+		// 駒打ちは自玉に影響しない。
+		moveList = generateDropMoves<US>(moveList, pos, target);
+		target |= pos.bbOf(Them);
+
+		// pin されていない駒は NonEvasion と同じ。
+		const Square ksq = pos.kingSquare(US);
+		const Square themKsq = pos.kingSquare(Them);
+		const Bitboard pinned = pos.pinnedBB();
+		const Bitboard notPinned = ~pinned;
+		moveList = GeneratePieceMoves<NonEvasion, Pawn           , US, false>()(moveList, pos, target, themKsq, notPinned);
+		moveList = GeneratePieceMoves<NonEvasion, Lance          , US, false>()(moveList, pos, target, themKsq, notPinned);
+		moveList = GeneratePieceMoves<NonEvasion, Knight         , US, false>()(moveList, pos, target, themKsq, notPinned);
+		moveList = GeneratePieceMoves<NonEvasion, Silver         , US, false>()(moveList, pos, target, themKsq, notPinned);
+		moveList = GeneratePieceMoves<NonEvasion, Bishop         , US, false>()(moveList, pos, target, themKsq, notPinned);
+		moveList = GeneratePieceMoves<NonEvasion, Rook           , US, false>()(moveList, pos, target, themKsq, notPinned);
+		moveList = GeneratePieceMoves<NonEvasion, GoldHorseDragon, US, false>()(moveList, pos, target, themKsq, notPinned);
+
+		// pin されている駒は 1 枚ずつ、pin の直線上だけに動かす。
+		Bitboard pinnedBB = pinned;
+		while (pinnedBB) {
+			const Square from = pinnedBB.firstOneFromSQ11();
+			const Bitboard fromBB = setMaskBB(from);
+			const Bitboard pinTarget = target & pinLineBB(from, ksq);
+			switch (pieceToPieceType(pos.piece(from))) {
+			case Pawn  : moveList = GeneratePieceMoves<NonEvasion, Pawn           , US, false>()(moveList, pos, pinTarget, themKsq, fromBB); break;
+			case Lance : moveList = GeneratePieceMoves<NonEvasion, Lance          , US, false>()(moveList, pos, pinTarget, themKsq, fromBB); break;
+			case Knight: break; // 桂馬は pin の直線上には動けない。
+			case Silver: moveList = GeneratePieceMoves<NonEvasion, Silver         , US, false>()(moveList, pos, pinTarget, themKsq, fromBB); break;
+			case Bishop: moveList = GeneratePieceMoves<NonEvasion, Bishop         , US, false>()(moveList, pos, pinTarget, themKsq, fromBB); break;
+			case Rook  : moveList = GeneratePieceMoves<NonEvasion, Rook           , US, false>()(moveList, pos, pinTarget, themKsq, fromBB); break;
+			default    : moveList = GeneratePieceMoves<NonEvasion, GoldHorseDragon, US, false>()(moveList, pos, pinTarget, themKsq, fromBB); break;
 			}
+		}
 
-			return moveList;
+		// 王手が掛かっていないので、玉の移動先の利きは今の局面の利きをそのまま調べれば良い。
+		Bitboard toBB = pos.attacksFrom<King>(US, ksq) & target;
+		while (toBB) {
+			const Square to = toBB.firstOneFromSQ11();
+			if (!pos.attackersToIsAny(Them, to))
+				(*moveList++).move = makeNonPromoteMove<NonEvasion>(King, ksq, to, pos);
+		}
+
+		return moveList;
+	}
+
+	// 部分特殊化
+	// 連続王手の千日手以外の反則手を排除した合法手生成
+	template <Color US> struct GenerateMoves<Legal, US> {
+		FORCE_INLINE ExtMove* operator () (ExtMove* moveList, const Position& pos) {
+			return generateLegalMoves<US, false>(moveList, pos);
 		}
 	};
 
@@ -530,21 +801,7 @@ namespace {
 	// Evasion のときに歩、飛、角と、香の2段目の不成も生成する。
 	template <Color US> struct GenerateMoves<LegalAll, US> {
 		FORCE_INLINE ExtMove* operator () (ExtMove* moveList, const Position& pos) {
-			ExtMove* curr = moveList;
-			const Bitboard pinned = pos.pinnedBB();
-
-			moveList = pos.inCheck() ?
-				GenerateMoves<Evasion, US, true>()(moveList, pos) : GenerateMoves<NonEvasion, US>()(moveList, pos);
-
-			// 玉の移動による自殺手と、pinされている駒の移動による自殺手を削除
-			while (curr != moveList) {
-				if (!pos.pseudoLegalMoveIsLegal<false, false>(curr->move, pinned))
-					curr->move = (--moveList)->move;
-				else
-					++curr;
-			}
-
-			return moveList;
+			return generateLegalMoves<US, true>(moveList, pos);
 		}
 	};
 }
@@ -571,8 +828,8 @@ template ExtMove* generateMoves<CapturePlusPro    >(ExtMove* moveList, const Pos
 template ExtMove* generateMoves<NonCaptureMinusPro>(ExtMove* moveList, const Position& pos);
 template ExtMove* generateMoves<Evasion           >(ExtMove* moveList, const Position& pos);
 template ExtMove* generateMoves<NonEvasion        >(ExtMove* moveList, const Position& pos);
+template ExtMove* generateMoves<Check             >(ExtMove* moveList, const Position& pos);
+template ExtMove* generateMoves<QuietCheck        >(ExtMove* moveList, const Position& pos);
 template ExtMove* generateMoves<Legal             >(ExtMove* moveList, const Position& pos);
-#if !defined NDEBUG || defined LEARN
 template ExtMove* generateMoves<LegalAll          >(ExtMove* moveList, const Position& pos);
-#endif
 template ExtMove* generateMoves<Recapture         >(ExtMove* moveList, const Position& pos, const Square to);
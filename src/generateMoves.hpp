@@ -15,8 +15,10 @@ enum MoveType {
 	Recapture,          // 特定の位置への取り返しの手
 	Evasion,            // 王手回避。歩, 飛, 角 の不成はは含まない。
 	NonEvasion,         // 王手が掛かっていないときの合法手 (玉の移動による自殺手、pinされている駒の移動による自殺手は回避しない。)
-	Legal,              // 王手が掛かっていれば Evasion, そうでないなら NonEvasion を生成し、
-                        // 玉の自殺手と pin されてる駒の移動による自殺手を排除。(連続王手の千日手は排除しない。)
+	Check,              // 王手が掛かっていないときの王手になる指し手。NonEvasion のうち王手になるもの。(pseudo legal)
+	QuietCheck,         // 駒を取らない王手。NonCaptureMinusPro と Drop のうち王手になるもの。(pseudo legal)
+	Legal,              // 王手が掛かっていれば Evasion, そうでないなら NonEvasion のうち、
+                        // 玉の自殺手と pin されてる駒の移動による自殺手を最初から生成しない。(連続王手の千日手は排除しない。)
 	LegalAll,           // Legal + 歩, 飛, 角 の不成、香の二段目の不成、香の三段目への駒を取らない不成を生成
 	MoveTypeNone
 };
@@ -64,7 +66,7 @@ template <MoveType MT, PromoteMode PM>
 inline Move selectedMakeMove(const PieceType pt, const Square from, const Square to, const Position& pos) {
 	static_assert(PM == Promote || PM == NonPromote, "");
 	assert(!((pt == Gold || pt == King || MT == Drop) && PM == Promote));
-	Move move = ((MT == NonCapture || MT == NonCaptureMinusPro) ? makeMove(pt, from, to) : makeCaptureMove(pt, from, to, pos));
+	Move move = ((MT == NonCapture || MT == NonCaptureMinusPro || MT == QuietCheck) ? makeMove(pt, from, to) : makeCaptureMove(pt, from, to, pos));
 	if (PM == Promote)
 		move |= promoteFlag();
 	return move;
@@ -92,4 +92,65 @@
 
 #define RESIGN
 
+#if 0
+// 浅い non PV node と静止探索の最初の深さで 3 手詰めを調べる。
+// 詰みの見逃しは減るが、bench で判定の結果と判定に使った局面数を見て有効にするか決めること。
+#define USE_MATE_3PLY
+#endif
+
+#if 0
+// 静止探索の最初の深さ(DepthQChecks)で、駒を取る手の後に駒を取らない王手も読む。
+#define QSEARCH_CHECKS
+#endif
+
+#if 1
+// 歩以外の持ち駒が 4 種類以上のとき、駒打ちを移動先 1 マス分ずつ AVX2 でまとめて書き込む。
+#if defined HAVE_AVX2
+#define USE_SIMD_DROP_MOVES
+#endif
+#endif
+
+#if 0
+// 飛車、角、香車の利きを、テーブルを引かずに Qugiy の方法で計算する。
+// RookAttack, BishopAttack, LanceAttack のテーブルを使わないので、キャッシュを評価関数や置換表に回せる。
+// perft ではテーブルの方が速かった。大きい評価関数と置換表を使った探索の NPS を見て有効にするか決めること。
+#if defined HAVE_AVX2
+#define USE_QUGIY_ATTACKS
+#endif
+#endif
+
+#if 0
+// 各マスへの先手、後手の利きの数を StateInfo に持ち、doMove() で差分更新する。
+// 玉の移動先や駒打ちの紐の判定 (attackersToIsAny()) が表引きになる代わりに、doMove() が重くなる。
+// "k" コマンドで doMove() と判定のそれぞれの速さを測って、有効にするか決めること。
+// 今の探索は利きをあまり引かないので、doMove() が重くなる分だけ NPS が下がった。
+#define USE_ATTACK_COUNTS
+#endif
+
+#if 0
+// 手番側が 1 手で過去の局面に戻せるなら、探索で alpha を千日手の評価値まで上げる。
+// 戻す手は cuckoo table で引くので、指し手生成はしない。
+// 探索の結果が変わるので、対局で強くなることを確かめてから有効にすること。
+#define USE_UPCOMING_REPETITION
+#endif
+
+#if 0
+// MovePicker で次に返す指し手の子局面の置換表、評価値のハッシュ、NNUE の重みを、
+// 今返す指し手の探索中に読み込んでおく。
+#define USE_MOVEPICKER_PREFETCH
+#endif
+
+#if 0
+// copy-make。doMove() で指す前の盤面 (Bitboard, 駒, 持ち駒, evalList) を StateInfo に写し、
+// undoMove() では差分を戻さずに書き戻すだけにする。
+// perft と bench を有効、無効で比べて決めること。
+#define USE_COPY_MAKE
+#endif
+
+#if 0
+// 枝刈りや延長の成功率などをスレッドごとに数え、bestmove の前に info string で表示する。
+// bench では search_stats.txt にも書き出す。
+#define USE_SEARCH_STATS
+#endif
+
 #endif // #ifndef APERY_IFDEF_HPP
@@ -83,6 +83,7 @@ namespace {
 		return result;
 	}
 
+#if !defined USE_QUGIY_ATTACKS
 	void initAttacks(const bool isBishop)
 	{
 		auto* attacks     = (isBishop ? BishopAttack      : RookAttack     );
@@ -110,7 +111,44 @@ namespace {
 			index += 1 << (64 - shift[sq]);
 		}
 	}
+#endif
 
+#if defined USE_QUGIY_ATTACKS
+	// delta の方向に盤の端まで進んだときの利き
+	Bitboard rayCalc(const Square square, const SquareDelta delta) {
+		Bitboard result = allZeroBB();
+		for (Square sq = square + delta;
+			 isInSquare(sq) && abs((int)makeRank(sq - delta) - (int)makeRank(sq)) <= 1;
+			 sq += delta)
+		{
+			result.setBit(sq);
+		}
+		return result;
+	}
+
+	// byte 単位で逆順にした Bitboard
+	Bitboard byteReverse(const Bitboard& bb) {
+		return Bitboard(__builtin_bswap64(bb.p(1)), __builtin_bswap64(bb.p(0)));
+	}
+
+	// Qugiy の利きの計算で使う mask を設定する。
+	// 他の利きのテーブルは rookAttack() などを使って作るので、最初に呼ぶこと。
+	void initQugiyMasks() {
+		for (Square sq = SQ11; sq < SquareNum; ++sq) {
+			QugiyRookMask[sq][0] = rayCalc(sq, DeltaW);
+			QugiyRookMask[sq][1] = byteReverse(rayCalc(sq, DeltaE));
+			QugiyBishopMask[sq][0] = rayCalc(sq, DeltaSW);
+			QugiyBishopMask[sq][1] = byteReverse(rayCalc(sq, DeltaNE));
+			QugiyBishopMask[sq][2] = rayCalc(sq, DeltaNW);
+			QugiyBishopMask[sq][3] = byteReverse(rayCalc(sq, DeltaSE));
+			const int part = Bitboard::part(sq);
+			QugiyLanceMask[Black][sq] = rayCalc(sq, DeltaN).p(part);
+			QugiyLanceMask[White][sq] = rayCalc(sq, DeltaS).p(part);
+		}
+	}
+#endif
+
+#if !defined USE_QUGIY_ATTACKS
 	// LanceBlockMask, LanceAttack の値を設定する。
 	void initLanceAttacks() {
 		for (Color c = Black; c < ColorNum; ++c) {
@@ -126,6 +164,7 @@ namespace {
 			}
 		}
 	}
+#endif
 
 	void initKingAttacks() {
 		for (Square sq = SQ11; sq < SquareNum; ++sq)
@@ -316,14 +355,20 @@ namespace {
 }
 
 void initTable() {
+#if defined USE_QUGIY_ATTACKS
+	initQugiyMasks();
+#else
 	initAttacks(false);
 	initAttacks(true);
+#endif
 	initKingAttacks();
 	initGoldAttacks();
 	initSilverAttacks();
 	initPawnAttacks();
 	initKnightAttacks();
+#if !defined USE_QUGIY_ATTACKS
 	initLanceAttacks();
+#endif
 	initSquareRelation();
 	initAttackToEdge();
 	initBetweenBB();
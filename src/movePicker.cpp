@@ -12,7 +12,7 @@ enum Stages {
 	MAIN_SEARCH, CAPTURES_INIT, GOOD_CAPTURES, KILLERS, COUNTERMOVE, QUIET_INIT, QUIET, BAD_CAPTURES,
 	EVASION, EVASIONS_INIT, ALL_EVASIONS,
 	PROBCUT, PROBCUT_INIT, PROBCUT_CAPTURES,
-	/*QSEARCH_WITH_CHECKS, QCAPTURES_1, CHECKS,*/
+	QSEARCH_WITH_CHECKS, QCHECK_CAPTURES_INIT, QCHECK_CAPTURES, QCHECKS_INIT, QCHECKS,
 	QSEARCH_NO_CHECKS, QCAPTURES_INIT, QCAPTURES,
 	QSEARCH_RECAPTURES, QRECAPTURES
 };
@@ -61,7 +61,10 @@ MovePicker::MovePicker(const Position& p, Move ttm, const Depth d, const Square
 	if (pos.inCheck())
         stage = EVASION;
 
-	// todo: ここで Stockfish は qcheck がある。
+#if defined QSEARCH_CHECKS
+	else if (d >= DepthQChecks)
+		stage = QSEARCH_WITH_CHECKS;
+#endif
 
 	else if (d > DepthQRecaptures)
         stage = QSEARCH_NO_CHECKS;
@@ -136,7 +139,7 @@ Move MovePicker::nextMove(bool skipQuiets) {
 
 	switch (stage) {
 
-	case MAIN_SEARCH: case EVASION: case QSEARCH_NO_CHECKS:
+	case MAIN_SEARCH: case EVASION: case QSEARCH_WITH_CHECKS: case QSEARCH_NO_CHECKS:
 	case PROBCUT:
 		++stage;
 		return ttMove;
@@ -210,7 +213,14 @@ Move MovePicker::nextMove(bool skipQuiets) {
 				&& move != ss->killers[0]
 				&& move != ss->killers[1]
 				&& move != countermove)
+			{
+#if defined USE_MOVEPICKER_PREFETCH
+				// 次に返す候補の子局面は、この指し手の探索中に読み込んでおく。
+				if (cur < endMoves)
+					pos.prefetchChild(*cur);
+#endif
 				return move;
+			}
 		}
 		++stage;
 		cur = moves; // Point to beginning of bad captures
@@ -251,19 +261,36 @@ Move MovePicker::nextMove(bool skipQuiets) {
 		}
 		break;
 
-	case QCAPTURES_INIT:
+	case QCHECK_CAPTURES_INIT: case QCAPTURES_INIT:
 		cur = moves;
 		endMoves = generateMoves<CapturePlusPro>(cur, pos);
 		scoreCaptures();
 		++stage;
 
-	case QCAPTURES:
+	case QCHECK_CAPTURES: case QCAPTURES:
 		while (cur < endMoves)
 		{
 			move = pick_best(cur++, endMoves);
 			if (move != ttMove)
 				return move;
 		}
+		if (stage == QCAPTURES)
+			break;
+		++stage;
+		[[fallthrough]];
+
+	case QCHECKS_INIT:
+		cur = moves;
+		endMoves = generateMoves<QuietCheck>(cur, pos);
+		++stage;
+
+	case QCHECKS:
+		while (cur < endMoves)
+		{
+			move = *cur++;
+			if (move != ttMove)
+				return move;
+		}
 		break;
 
 	case QSEARCH_RECAPTURES:
@@ -7,6 +7,7 @@
 
 Key Position::zobrist_[PieceTypeNum][SquareNum][ColorNum];
 Key Position::zobHand_[HandPieceNum][ColorNum];
+u32 Position::cuckoo_[Position::CuckooSize];
 Key Position::zobExclusion_;
 
 const CharToPieceUSI g_charToPieceUSI;
@@ -40,14 +41,14 @@ CheckInfo::CheckInfo(const Position& pos) {
 	checkBB[Rook     ] = pos.attacksFrom<Rook  >(ksq);
 	checkBB[Gold     ] = pos.attacksFrom<Gold  >(them, ksq);
 	checkBB[King     ] = allZeroBB();
-	// todo: ここで AVX2 使えそう。
-	//       checkBB のreadアクセスは switch (pt) で場合分けして、余計なコピー減らした方が良いかも。
+	// todo: checkBB のreadアクセスは switch (pt) で場合分けして、余計なコピー減らした方が良いかも。
 	checkBB[ProPawn  ] = checkBB[Gold];
 	checkBB[ProLance ] = checkBB[Gold];
 	checkBB[ProKnight] = checkBB[Gold];
 	checkBB[ProSilver] = checkBB[Gold];
-	checkBB[Horse    ] = checkBB[Bishop] | pos.attacksFrom<King>(ksq);
-	checkBB[Dragon   ] = checkBB[Rook  ] | pos.attacksFrom<King>(ksq);
+	const Bitboard256 horseDragon = Bitboard256(checkBB[Bishop], checkBB[Rook]) | Bitboard256(pos.attacksFrom<King>(ksq));
+	checkBB[Horse    ] = horseDragon.bb(0);
+	checkBB[Dragon   ] = horseDragon.bb(1);
 }
 
 Bitboard Position::attacksFrom(const PieceType pt, const Color c, const Square sq, const Bitboard& occupied) {
@@ -73,6 +74,99 @@ Bitboard Position::attacksFrom(const PieceType pt, const Color c, const Square s
 	return allOneBB();
 }
 
+#if defined USE_ATTACK_COUNTS
+namespace {
+#if defined HAVE_AVX2
+	// 32 bit の各 bit を、立っていれば 0xff、立っていなければ 0 の 1 byte に広げる。
+	FORCE_INLINE __m256i expandBitsToBytes(const u32 bits) {
+		const __m256i shuffle = _mm256_setr_epi64x(0x0000000000000000, 0x0101010101010101, 0x0202020202020202, 0x0303030303030303);
+		const __m256i bitSelect = _mm256_set1_epi64x(0x8040201008040201);
+		const __m256i v = _mm256_and_si256(_mm256_shuffle_epi8(_mm256_set1_epi32(bits), shuffle), bitSelect);
+		return _mm256_cmpeq_epi8(v, bitSelect);
+	}
+#endif
+
+	// plus のマスの利き数を 1 増やし、minus のマスの利き数を 1 減らす。
+	FORCE_INLINE void addAttackCount(u8 attackCount[96], const Bitboard& plus, const Bitboard& minus) {
+#if defined HAVE_AVX2
+		// 81 マスの bit をマスの番号順に 32 bit ずつ取り出し、1 マス 1 byte に広げてまとめて足し引きする。
+		// p(0) の 63 bit目は使っていないので 0 のはず。
+		const u32 plusBits[3] = {static_cast<u32>(plus.p(0)),
+								 static_cast<u32>((plus.p(0) >> 32) | (plus.p(1) << 31)),
+								 static_cast<u32>(plus.p(1) >> 1)};
+		const u32 minusBits[3] = {static_cast<u32>(minus.p(0)),
+								  static_cast<u32>((minus.p(0) >> 32) | (minus.p(1) << 31)),
+								  static_cast<u32>(minus.p(1) >> 1)};
+		for (int i = 0; i < 3; ++i) {
+			__m256i* const p = reinterpret_cast<__m256i*>(attackCount) + i;
+			// 広げた値は 0xff (-1) なので、plus は引き、minus は足す。
+			const __m256i v = _mm256_sub_epi8(_mm256_load_si256(p), expandBitsToBytes(plusBits[i]));
+			_mm256_store_si256(p, _mm256_add_epi8(v, expandBitsToBytes(minusBits[i])));
+		}
+#else
+		Bitboard bb = plus;
+		while (bb)
+			++attackCount[bb.firstOneFromSQ11()];
+		bb = minus;
+		while (bb)
+			--attackCount[bb.firstOneFromSQ11()];
+#endif
+	}
+}
+
+void Position::computeAttackCounts(u8 attackCount[ColorNum][96]) const {
+	memset(attackCount, 0, sizeof(StateInfo::attackCount));
+	Bitboard bb = occupiedBB();
+	while (bb) {
+		const Square sq = bb.firstOneFromSQ11();
+		const Color c = pieceToColor(piece(sq));
+		addAttackCount(attackCount[c], attacksFrom(pieceToPieceType(piece(sq)), c, sq), allZeroBB());
+	}
+}
+
+void Position::updateAttackCounts(const Move move, const Bitboard& prevOccupied) {
+	const Color us = turn();
+	const Square to = move.to();
+	const Bitboard& occupied = occupiedBB();
+
+	// 駒が置かれたマスと、駒が無くなったマス。
+	// 駒を取る手の to は駒が入れ替わるだけで、遠隔駒の利きは変わらない。
+	Bitboard changed = prevOccupied ^ occupied;
+	// changed のマスに届いている遠隔駒は、利きが伸びるか遮られる。
+	// 動いた駒は後でまとめて扱うので除く。
+	Bitboard sliders = allZeroBB();
+	do {
+		const Square sq = changed.firstOneFromSQ11();
+		sliders |= (attacksFrom<Rook  >(sq, occupied) & bbOf(Rook  , Dragon))
+			| (attacksFrom<Bishop>(sq, occupied) & bbOf(Bishop, Horse ))
+			| (attacksFrom<Lance >(White, sq, occupied) & bbOf(Lance, Black))
+			| (attacksFrom<Lance >(Black, sq, occupied) & bbOf(Lance, White));
+	} while (changed);
+	sliders.clearBit(to);
+
+	while (sliders) {
+		const Square sq = sliders.firstOneFromSQ11();
+		const Color c = pieceToColor(piece(sq));
+		const PieceType pt = pieceToPieceType(piece(sq));
+		const Bitboard prevAttacks = attacksFrom(pt, c, sq, prevOccupied);
+		const Bitboard attacks = attacksFrom(pt, c, sq, occupied);
+		addAttackCount(st_->attackCount[c], prevAttacks.notThisAnd(attacks), attacks.notThisAnd(prevAttacks));
+	}
+
+	const Bitboard toAttacks = attacksFrom(pieceToPieceType(piece(to)), us, to, occupied);
+	if (move.isDrop())
+		addAttackCount(st_->attackCount[us], toAttacks, allZeroBB());
+	else {
+		const Square from = move.from();
+		addAttackCount(st_->attackCount[us], toAttacks, attacksFrom(move.pieceTypeFrom(), us, from, prevOccupied));
+		if (move.cap()) {
+			const Color them = oppositeColor(us);
+			addAttackCount(st_->attackCount[them], allZeroBB(), attacksFrom(move.cap(), them, to, prevOccupied));
+		}
+	}
+}
+#endif
+
 // 実際に指し手が合法手かどうか判定
 // 連続王手の千日手は排除しない。
 // 確実に駒打ちではないときは、MUSTNOTDROP == true とする。
@@ -223,6 +317,82 @@ bool Position::moveIsLegal(const Move move) const {
 }
 #endif
 
+#if defined USE_MOVEPICKER_PREFETCH
+Key Position::keyAfter(const Move move) const {
+	const Color us = turn();
+	const Square to = move.to();
+	Key boardKey = getBoardKey() ^ zobTurn();
+	Key handKey = getHandKey();
+	if (move.isDrop()) {
+		const PieceType ptTo = move.pieceTypeDropped();
+		handKey -= zobHand(pieceTypeToHandPiece(ptTo), us);
+		boardKey += zobrist(ptTo, to, us);
+	}
+	else {
+		const Square from = move.from();
+		const PieceType ptFrom = move.pieceTypeFrom();
+		const PieceType ptCaptured = move.cap();
+		boardKey -= zobrist(ptFrom, from, us);
+		boardKey += zobrist(move.pieceTypeTo(ptFrom), to, us);
+		if (ptCaptured) {
+			boardKey -= zobrist(ptCaptured, to, oppositeColor(us));
+			handKey += zobHand(pieceTypeToHandPiece(ptCaptured), us);
+		}
+	}
+	return boardKey + handKey;
+}
+
+void Position::prefetchChild(const Move move) const {
+	const Key key = keyAfter(move);
+	prefetch(TT.firstEntry(key));
+	prefetch_evalhash(key);
+
+#if defined(EVAL_NNUE)
+	// doMove() で st_->cl に入れるものと同じ、変化する駒の BonaPiece を求める。
+	// 玉が動くときは差分計算しないので読み込まない。
+	const Color us = turn();
+	const Square to = move.to();
+	ChangedLists cl;
+	cl.size = 1;
+	if (move.isDrop()) {
+		const PieceType ptTo = move.pieceTypeDropped();
+		const HandPiece hpTo = pieceTypeToHandPiece(ptTo);
+		const Piece pcTo = colorAndPieceTypeToPiece(us, ptTo);
+		const int listIndex = evalList_.squareHandToList[HandPieceToSquareHand[us][hpTo] + static_cast<int>(hand(us).numOf(hpTo))];
+		cl.clistpair[0].oldlist[0] = evalList_.list0[listIndex];
+		cl.clistpair[0].oldlist[1] = evalList_.list1[listIndex];
+		cl.clistpair[0].newlist[0] = kppArray[pcTo         ] + to;
+		cl.clistpair[0].newlist[1] = kppArray[inverse(pcTo)] + inverse(to);
+	}
+	else {
+		const Square from = move.from();
+		const PieceType ptFrom = move.pieceTypeFrom();
+		if (ptFrom == King)
+			return;
+		const Piece pcTo = colorAndPieceTypeToPiece(us, move.pieceTypeTo(ptFrom));
+		const int fromListIndex = evalList_.squareHandToList[from];
+		cl.clistpair[0].oldlist[0] = evalList_.list0[fromListIndex];
+		cl.clistpair[0].oldlist[1] = evalList_.list1[fromListIndex];
+		cl.clistpair[0].newlist[0] = kppArray[pcTo         ] + to;
+		cl.clistpair[0].newlist[1] = kppArray[inverse(pcTo)] + inverse(to);
+
+		const PieceType ptCaptured = move.cap();
+		if (ptCaptured) {
+			const HandPiece hpCaptured = pieceTypeToHandPiece(ptCaptured);
+			const int toListIndex = evalList_.squareHandToList[to];
+			const int handnum = hand(us).numOf(hpCaptured) + 1;
+			cl.clistpair[1].oldlist[0] = evalList_.list0[toListIndex];
+			cl.clistpair[1].oldlist[1] = evalList_.list1[toListIndex];
+			cl.clistpair[1].newlist[0] = kppHandArray[us                ][hpCaptured] + handnum;
+			cl.clistpair[1].newlist[1] = kppHandArray[oppositeColor(us)][hpCaptured] + handnum;
+			cl.size = 2;
+		}
+	}
+	Eval::prefetch_nnue(*this, cl);
+#endif
+}
+#endif
+
 // 局面の更新
 void Position::doMove(const Move move, StateInfo& newSt) {
 	const CheckInfo ci(*this);
@@ -236,11 +406,17 @@ void Position::doMove(const Move move, StateInfo& newSt, const CheckInfo& ci, co
 	assert(&newSt != st_);
 
 	nodes_++;
+#if defined USE_ATTACK_COUNTS
+	const Bitboard prevOccupied = occupiedBB();
+#endif
 	Key boardKey = getBoardKey();
 	Key handKey = getHandKey();
 	boardKey ^= zobTurn();
 
     memcpy(&newSt, st_, offsetof(StateInfo, boardKey));
+#if defined USE_COPY_MAKE
+	saveBoard(newSt.board);
+#endif
 	newSt.previous = st_;
 	st_ = &newSt;
 
@@ -413,10 +589,14 @@ void Position::doMove(const Move move, StateInfo& newSt, const CheckInfo& ci, co
 		}
 	}
 	goldsBB_ = bbOf(Gold, ProPawn, ProLance, ProKnight, ProSilver);
+#if defined USE_ATTACK_COUNTS
+	updateAttackCounts(move, prevOccupied);
+#endif
 
 	st_->boardKey = boardKey;
 	st_->handKey = handKey;
 	++st_->pliesFromNull;
+	incBoardKeyCount(boardKey);
 
 	turn_ = oppositeColor(us);
 	st_->hand = hand(turn());
@@ -428,6 +608,11 @@ void Position::undoMove(const Move move) {
 	assert(isOK());
 	assert(move);
 
+#if defined USE_COPY_MAKE
+	// 指す前の盤面を書き戻すだけで良い。
+	restoreBoard(st_->board);
+	turn_ = oppositeColor(turn());
+#else
 	const Color them = turn();
 	const Color us = oppositeColor(them);
 	const Square to = move.to();
@@ -497,9 +682,12 @@ void Position::undoMove(const Move move) {
 	// Black と White の or を取る方が速いはず。
 	byTypeBB_[Occupied] = bbOf(Black) | bbOf(White);
 	goldsBB_ = bbOf(Gold, ProPawn, ProLance, ProKnight, ProSilver);
+#endif
 
 	// key などは StateInfo にまとめられているので、
 	// previous のポインタを st_ に代入するだけで良い。
+	// (利き数も StateInfo に持っているので、戻す処理は要らない。)
+	decBoardKeyCount(st_->boardKey);
 	st_ = st_->previous;
 	--gamePly_;
 
@@ -513,6 +701,9 @@ void Position::doNullMove(StateInfo& backUpSt) {
 	StateInfo* src = (DO ? st_ : &backUpSt);
 	StateInfo* dst = (DO ? &backUpSt : st_);
 
+	if (!DO)
+		decBoardKeyCount(st_->boardKey);
+
 	dst->boardKey      = src->boardKey;
 	dst->handKey       = src->handKey;
 	dst->pliesFromNull = src->pliesFromNull;
@@ -520,11 +711,15 @@ void Position::doNullMove(StateInfo& backUpSt) {
 	turn_ = oppositeColor(turn());
 
 #if defined(EVAL_NNUE)
-	dst->accumulator = src->accumulator;
+	// 盤面は変わらないので、accumulation は st_ のものをそのまま使う。(1KB 以上あるのでコピーしない)
+	// null move の先で計算した accumulation も手番に依らないので、戻した後でも正しい。退避するのは評価値だけ。
+	dst->accumulator.score = src->accumulator.score;
+	dst->accumulator.computed_score = src->accumulator.computed_score;
 #endif
 
 	if (DO) {
 		st_->boardKey ^= zobTurn();
+		incBoardKeyCount(st_->boardKey);
 		prefetch(TT.firstEntry(st_->key()));
 		st_->pliesFromNull = 0;
 		st_->continuousCheck[turn()] = 0;
@@ -1500,6 +1695,43 @@ Move Position::mateMoveIn1Ply() {
 	return (turn() == Black ? mateMoveIn1Ply<Black>() : mateMoveIn1Ply<White>());
 }
 
+// 王手を全て試し、全ての応手に対して 1 手詰めがあるかを調べる。
+// 応手のどれか一つでも 1 手詰めが無ければ、その王手は直ちに打ち切る。
+// 指し手のバッファは全てスタックに置き、動的なメモリ確保はしない。
+Move Position::mateMoveIn3Ply() {
+	assert(!inCheck());
+
+	const CheckInfo ci(*this);
+	StateInfo st[2];
+	ExtMove checks[MaxLegalMoves];
+	ExtMove* const checksEnd = generateMoves<Check>(checks, *this);
+
+	for (ExtMove* check = checks; check != checksEnd; ++check) {
+		const Move move = check->move;
+		if (!pseudoLegalMoveIsLegal<false, false>(move, ci.pinned))
+			continue;
+
+		doMove(move, st[0], ci, true);
+
+		// 合駒などの不成も含めて全ての応手を調べないと詰みとは言えないので LegalAll を使う。
+		const CheckInfo evasionCi(*this);
+		bool mated = true;
+		for (MoveList<LegalAll> ml(*this); !ml.end() && mated; ++ml) {
+			doMove(ml.move(), st[1], evasionCi, moveGivesCheck(ml.move(), evasionCi));
+			// 逆王手されたら 1 手詰めは調べられないので、詰まないものとする。
+			mated = !inCheck() && mateMoveIn1Ply() != Move::moveNone();
+			undoMove(ml.move());
+		}
+
+		undoMove(move);
+
+		if (mated)
+			return move;
+	}
+
+	return Move::moveNone();
+}
+
 void Position::initZobrist() {
 	// zobTurn_ は 1 であり、その他は 1桁目を使わない。
 	// zobTurn のみ xor で更新する為、他の桁に影響しないようにする為。
@@ -1515,6 +1747,29 @@ void Position::initZobrist() {
 		zobHand_[hp][White] = g_mt64bit.random() & ~UINT64_C(1);
 	}
 	zobExclusion_ = g_mt64bit.random() & ~UINT64_C(1);
+
+	// 千日手の先読み用の cuckoo table
+	std::fill(std::begin(cuckoo_), std::end(cuckoo_), 0);
+	for (Color c = Black; c < ColorNum; ++c) {
+		for (const PieceType pt : {Silver, Bishop, Rook, Gold, King, ProPawn, ProLance, ProKnight, ProSilver, Horse, Dragon}) {
+			for (Square from = SQ11; from < SquareNum; ++from) {
+				Bitboard toBB = attacksFrom(pt, c, from, allZeroBB());
+				while (toBB) {
+					const Square to = toBB.firstOneFromSQ11();
+					u32 m = cuckooMove(from, to, pt, c);
+					int i = cuckooH1(cuckooKey(m));
+					// 追い出した要素を、もう一方の場所に入れ直す。
+					while (true) {
+						std::swap(cuckoo_[i], m);
+						if (m == 0)
+							break;
+						const Key key = cuckooKey(m);
+						i = (i == cuckooH1(key) ? cuckooH2(key) : cuckooH1(key));
+					}
+				}
+			}
+		}
+	}
 }
 
 void Position::print() const {
@@ -1547,6 +1802,9 @@ bool Position::isOK() const {
 	const bool debugStateHand    = debugAll || false;
 	const bool debugPiece        = debugAll || false;
 	const bool debugMaterial     = debugAll || false;
+#if defined USE_ATTACK_COUNTS
+	const bool debugAttackCount  = debugAll || false;
+#endif
 
 	int failedStep = 0;
 	if (debugBitboards) {
@@ -1636,6 +1894,20 @@ bool Position::isOK() const {
 			goto incorrect_position;
 	}
 
+#if defined USE_ATTACK_COUNTS
+	++failedStep;
+	if (debugAttackCount) {
+		alignas(32) u8 attackCount[ColorNum][96];
+		computeAttackCounts(attackCount);
+		for (Color c = Black; c < ColorNum; ++c) {
+			for (Square sq = SQ11; sq < SquareNum; ++sq) {
+				if (attackCount[c][sq] != st_->attackCount[c][sq])
+					goto incorrect_position;
+			}
+		}
+	}
+#endif
+
 	++failedStep;
 	{
 		int i;
@@ -1695,7 +1967,8 @@ RepetitionType Position::isDraw(const int checkMaxPly) const {
 	const int e = std::min(st_->pliesFromNull, checkMaxPly);
 
 	// 4手掛けないと千日手には絶対にならない。
-	if (i <= e) {
+	// 同じ盤面が過去に無ければ、StateInfo を辿らなくても千日手でも優等、劣等局面でもない。
+	if (i <= e && 1 < boardKeyCount_[boardKeyCountIndex(st_->boardKey)]) {
 		// 現在の局面と、少なくとも 4 手戻らないと同じ局面にならない。
 		// ここでまず 2 手戻る。
 		StateInfo* stp = st_->previous->previous;
@@ -1726,6 +1999,51 @@ RepetitionType Position::isDraw(const int checkMaxPly) const {
 	return NotRepetition;
 }
 
+// 手番側の駒を 1 手動かすと、pliesFromNull の範囲の過去の局面 (相手の手番) と同じ盤面になるかを調べる。
+// 盤面が同じなら持ち駒の合計も同じなので、相手の持ち駒がその局面以下なら、手番側は同じか優越した局面に戻せる。
+// 手番側の連続王手で戻す場合は負けになるかも知れないので、手番側が直前に王手していないときだけ調べる。
+bool Position::hasUpcomingRepetition(const int checkMaxPly) const {
+	const int e = std::min(st_->pliesFromNull, checkMaxPly);
+	const Color us = turn();
+	const Color them = oppositeColor(us);
+	if (e < 3 || st_->continuousCheck[us] != 0)
+		return false;
+
+	const Key originalKey = st_->boardKey ^ zobTurn();
+	StateInfo* stp = st_->previous;
+	for (int i = 3; i <= e; i += 2) {
+		stp = stp->previous->previous;
+		const Key moveKey = stp->boardKey - originalKey;
+		u32 m = cuckoo_[cuckooH1(moveKey)];
+		if (m == 0 || cuckooKey(m) != moveKey) {
+			m = cuckoo_[cuckooH2(moveKey)];
+			if (m == 0 || cuckooKey(m) != moveKey)
+				continue;
+		}
+
+		const Square from = cuckooFrom(m);
+		const Square to = cuckooTo(m);
+		if (cuckooColor(m) != us
+			|| piece(from) != colorAndPieceTypeToPiece(us, cuckooPieceType(m))
+			|| piece(to) != Empty
+			|| betweenBB(from, to).andIsAny(occupiedBB()))
+		{
+			continue;
+		}
+
+#if defined BAN_BLACK_REPETITION
+		if (us == Black && stp->handKey == st_->handKey)
+			continue;
+#elif defined BAN_WHITE_REPETITION
+		if (us == White && stp->handKey == st_->handKey)
+			continue;
+#endif
+		if (stp->hand.isEqualOrSuperior(hand(them)))
+			return true;
+	}
+	return false;
+}
+
 namespace {
 	void printHandPiece(const Position& pos, const HandPiece hp, const Color c, const std::string& str) {
 		if (pos.hand(c).numOf(hp)) {
@@ -1787,10 +2105,6 @@ void Position::set(const std::string& sfen, Thread* th) {
 		else
 			goto INCORRECT;
 	}
-	kingSquare_[Black] = bbOf(King, Black).constFirstOneFromSQ11();
-	kingSquare_[White] = bbOf(King, White).constFirstOneFromSQ11();
-	goldsBB_ = bbOf(Gold, ProPawn, ProLance, ProKnight, ProSilver);
-
 	// 手番
 	while (ss.get(token) && token != ' ') {
 		if (token == 'b')
@@ -1822,14 +2136,29 @@ void Position::set(const std::string& sfen, Thread* th) {
 	ss >> gamePly_;
 	gamePly_ = std::max(2 * (gamePly_ - 1), 0) + static_cast<int>(turn() == White);
 
+	initState(th);
+	return;
+INCORRECT:
+	std::cout << "incorrect SFEN string : " << sfen << std::endl;
+}
+
+void Position::initState(Thread* th) {
+	kingSquare_[Black] = bbOf(King, Black).constFirstOneFromSQ11();
+	kingSquare_[White] = bbOf(King, White).constFirstOneFromSQ11();
+	goldsBB_ = bbOf(Gold, ProPawn, ProLance, ProKnight, ProSilver);
+
 	// 残り時間, hash key, (もし実装するなら)駒番号などをここで設定
 	st_->boardKey = computeBoardKey();
 	st_->handKey = computeHandKey();
 	st_->hand = hand(turn());
+	incBoardKeyCount(st_->boardKey);
 
 	setEvalList();
 	findCheckers();
 	st_->material = computeMaterial();
+#if defined USE_ATTACK_COUNTS
+	computeAttackCounts(st_->attackCount);
+#endif
 
 #if defined(EVAL_NNUE)
 	if (g_load_eval_completed) {
@@ -1838,10 +2167,239 @@ void Position::set(const std::string& sfen, Thread* th) {
 #endif
 
 	thisThread_ = th;
+}
 
-	return;
-INCORRECT:
-	std::cout << "incorrect SFEN string : " << sfen << std::endl;
+namespace {
+	// PackedPosition の駒のハフマン符号。PieceType の Occupied は空きのマスとして使う。
+	// 盤上の駒は、この後に成りフラグ (金以外) と先後フラグの 1bit ずつが続く。
+	// 持ち駒は、盤上の空きと区別する為の最下位 bit を除いた符号に、同じく成りフラグ (常に 0) と先後フラグが続く。
+	struct HuffmanCode {
+		u32 code;
+		int bits;
+	};
+	const HuffmanCode PackedCodes[King] = {
+		{0x00, 1}, // 空き
+		{0x01, 2}, // 歩
+		{0x03, 4}, // 香
+		{0x0b, 4}, // 桂
+		{0x07, 4}, // 銀
+		{0x1f, 6}, // 角
+		{0x3f, 6}, // 飛
+		{0x0f, 5}, // 金
+	};
+
+	// 先頭 6bit (持ち駒なら 5bit) の値から、駒の種類と符号の bit 数を引く表。
+	struct HuffmanDecodeTable {
+		HuffmanDecodeTable() {
+			for (u32 v = 0; v < 64; ++v) {
+				for (PieceType pt = Occupied; pt < King; ++pt) {
+					const u32 mask = (1u << PackedCodes[pt].bits) - 1;
+					if ((v & mask) == PackedCodes[pt].code)
+						board[v] = {pt, PackedCodes[pt].bits};
+					if (pt != Occupied && (v & (mask >> 1)) == (PackedCodes[pt].code >> 1) && v < 32)
+						hand[v] = {pt, PackedCodes[pt].bits - 1};
+				}
+			}
+		}
+		struct Entry {
+			PieceType pt;
+			int bits;
+		};
+		Entry board[64];
+		Entry hand[32];
+	};
+	const HuffmanDecodeTable PackedDecodeTable;
+
+	// 下位 bit から順に書く。範囲外 (駒が 40 枚より多い局面) への書き込みを防ぐ為に、余分に持つ。
+	class PackedWriter {
+	public:
+		PackedWriter() : cursor_(0) { memset(data_, 0, sizeof(data_)); }
+		void write(const u32 value, const int bits) {
+			if (cursor_ + bits <= 256) {
+				for (int i = 0; i < bits; ++i, ++cursor_)
+					data_[cursor_ >> 3] |= ((value >> i) & 1) << (cursor_ & 7);
+			}
+			else
+				cursor_ = 257;
+		}
+		int cursor() const { return cursor_; }
+		const u8* data() const { return data_; }
+	private:
+		u8 data_[32];
+		int cursor_;
+	};
+
+	class PackedReader {
+	public:
+		explicit PackedReader(const PackedPosition& pp) : cursor_(0) {
+			memcpy(&data_[0], pp.data, sizeof(pp.data));
+			memset(&data_[32], 0, sizeof(data_) - 32);
+		}
+		// cursor_ から 8bit 先まで見る。(書き込みの終わりより後ろは 0)
+		u32 peek() const {
+			// 壊れたデータで範囲外を読まないようにする。
+			const int i = std::min(cursor_ >> 3, 32);
+			return ((data_[i] | (data_[i + 1] << 8)) >> (cursor_ & 7)) & 0xff;
+		}
+		u32 read(const int bits) {
+			const u32 v = peek() & ((1u << bits) - 1);
+			cursor_ += bits;
+			return v;
+		}
+		Piece readBoardPiece() {
+			const HuffmanDecodeTable::Entry& e = PackedDecodeTable.board[peek() & 0x3f];
+			cursor_ += e.bits;
+			if (e.pt == Occupied)
+				return Empty;
+			const bool promoted = (e.pt != Gold && read(1));
+			const Color c = static_cast<Color>(read(1));
+			return colorAndPieceTypeToPiece(c, (promoted ? e.pt + PTPromote : e.pt));
+		}
+		Piece readHandPiece() {
+			const HuffmanDecodeTable::Entry& e = PackedDecodeTable.hand[peek() & 0x1f];
+			cursor_ += e.bits + (e.pt != Gold ? 1 : 0);
+			const Color c = static_cast<Color>(read(1));
+			return colorAndPieceTypeToPiece(c, e.pt);
+		}
+		int cursor() const { return cursor_; }
+	private:
+		u8 data_[34];
+		int cursor_;
+	};
+}
+
+bool Position::setFromPacked(const PackedPosition& pp, Thread* th) {
+	// 壊れたデータから玉の無い局面や、Hand の bit field が溢れる局面を作らないように、全て調べる。
+	static const int MaxHandNum[HandPieceNum] = {18, 4, 4, 4, 4, 2, 2};
+	clear();
+
+	PackedReader reader(pp);
+	turn_ = static_cast<Color>(reader.read(1));
+	const Square ksqBlack = static_cast<Square>(reader.read(7));
+	const Square ksqWhite = static_cast<Square>(reader.read(7));
+	if (SquareNum <= ksqBlack || SquareNum <= ksqWhite || ksqBlack == ksqWhite)
+		return false;
+
+	int pieceNum = 2;
+	for (Square sq = SQ11; sq < SquareNum; ++sq) {
+		if (sq == ksqBlack)
+			setPiece(BKing, sq);
+		else if (sq == ksqWhite)
+			setPiece(WKing, sq);
+		else {
+			const Piece pc = reader.readBoardPiece();
+			if (256 < reader.cursor())
+				return false;
+			if (pc != Empty) {
+				setPiece(pc, sq);
+				++pieceNum;
+			}
+		}
+	}
+	while (reader.cursor() < 256) {
+		const Piece pc = reader.readHandPiece();
+		const HandPiece hp = pieceTypeToHandPiece(pieceToPieceType(pc));
+		if (256 < reader.cursor()
+			|| 40 < ++pieceNum
+			|| MaxHandNum[hp] <= static_cast<int>(hand_[pieceToColor(pc)].numOf(hp)))
+		{
+			return false;
+		}
+		hand_[pieceToColor(pc)].plusOne(hp);
+	}
+	if (reader.cursor() != 256 || 40 < pieceNum)
+		return false;
+
+	gamePly_ = static_cast<int>(turn() == White);
+	initState(th);
+	return true;
+}
+
+bool Position::pack(PackedPosition& pp) const {
+	PackedWriter writer;
+	writer.write(turn(), 1);
+	writer.write(kingSquare(Black), 7);
+	writer.write(kingSquare(White), 7);
+	for (Square sq = SQ11; sq < SquareNum; ++sq) {
+		const Piece pc = piece(sq);
+		const PieceType pt = pieceToPieceType(pc);
+		if (pt == King)
+			continue;
+		const bool promoted = (ProPawn <= pt);
+		const PieceType rawPt = (promoted ? pt - PTPromote : pt);
+		writer.write(PackedCodes[rawPt].code, PackedCodes[rawPt].bits);
+		if (pc == Empty)
+			continue;
+		if (rawPt != Gold)
+			writer.write(promoted, 1);
+		writer.write(pieceToColor(pc), 1);
+	}
+	for (Color c = Black; c < ColorNum; ++c) {
+		for (PieceType pt = Pawn; pt < King; ++pt) {
+			const int num = hand(c).numOf(pieceTypeToHandPiece(pt));
+			for (int i = 0; i < num; ++i) {
+				writer.write(PackedCodes[pt].code >> 1, PackedCodes[pt].bits - 1);
+				if (pt != Gold)
+					writer.write(0, 1);
+				writer.write(c, 1);
+			}
+		}
+	}
+	if (writer.cursor() != 256)
+		return false;
+	memcpy(pp.data, writer.data(), sizeof(pp.data));
+	return true;
+}
+
+std::string Position::toSFEN() const {
+	// PieceType の成りを除いたものを index とする。
+	const char* const USIPieceChars = " PLNSBRGK";
+	std::ostringstream ss;
+	for (Rank r = Rank1; r < RankNum; ++r) {
+		int empty = 0;
+		for (File f = File9; File1 <= f; --f) {
+			const Piece pc = piece(makeSquare(f, r));
+			if (pc == Empty) {
+				++empty;
+				continue;
+			}
+			if (empty != 0) {
+				ss << empty;
+				empty = 0;
+			}
+			const PieceType pt = pieceToPieceType(pc);
+			const PieceType rawPt = (ProPawn <= pt ? pt - PTPromote : pt);
+			if (rawPt != pt)
+				ss << '+';
+			const char ch = USIPieceChars[rawPt];
+			ss << static_cast<char>(pieceToColor(pc) == Black ? ch : ch - 'A' + 'a');
+		}
+		if (empty != 0)
+			ss << empty;
+		if (r != Rank9)
+			ss << '/';
+	}
+	ss << (turn() == Black ? " b " : " w ");
+
+	// 持ち駒は飛、角、金、銀、桂、香、歩の順に書く。
+	const HandPiece handOrder[] = {HRook, HBishop, HGold, HSilver, HKnight, HLance, HPawn};
+	const char* const handChars = "RBGSNLP";
+	bool noHand = true;
+	for (Color c = Black; c < ColorNum; ++c) {
+		for (int i = 0; i < 7; ++i) {
+			const u32 num = hand(c).numOf(handOrder[i]);
+			if (num == 0)
+				continue;
+			if (1 < num)
+				ss << num;
+			ss << static_cast<char>(c == Black ? handChars[i] : handChars[i] - 'A' + 'a');
+			noHand = false;
+		}
+	}
+	if (noHand)
+		ss << '-';
+	ss << ' ' << (gamePly() / 2 + 1);
+	return ss.str();
 }
 
 bool Position::moveGivesCheck(const Move move) const {
@@ -1888,33 +2446,33 @@ void Position::clear() {
 
 // 先手、後手に関わらず、sq へ移動可能な Bitboard を返す。
 Bitboard Position::attackersTo(const Square sq, const Bitboard& occupied) const {
-	const Bitboard golds = goldsBB();
-	return (((attacksFrom<Pawn  >(Black, sq          ) & bbOf(Pawn  ))
-			 | (attacksFrom<Lance >(Black, sq, occupied) & bbOf(Lance ))
-			 | (attacksFrom<Knight>(Black, sq          ) & bbOf(Knight))
-			 | (attacksFrom<Silver>(Black, sq          ) & bbOf(Silver))
-			 | (attacksFrom<Gold  >(Black, sq          ) & golds       ))
-			& bbOf(White))
-		| (((attacksFrom<Pawn  >(White, sq          ) & bbOf(Pawn  ))
-			| (attacksFrom<Lance >(White, sq, occupied) & bbOf(Lance ))
-			| (attacksFrom<Knight>(White, sq          ) & bbOf(Knight))
-			| (attacksFrom<Silver>(White, sq          ) & bbOf(Silver))
-			| (attacksFrom<Gold  >(White, sq          ) & golds))
-		   & bbOf(Black))
-		| (attacksFrom<Bishop>(sq, occupied) & bbOf(Bishop, Horse        ))
-		| (attacksFrom<Rook  >(sq, occupied) & bbOf(Rook  , Dragon       ))
+	// 後手の駒の利きと先手の駒の利き、角と飛車の利きをそれぞれ組にして同時に計算する。
+	const Bitboard256 stepAttackers =
+		((Bitboard256(attacksFrom<Pawn  >(Black, sq          ), attacksFrom<Pawn  >(White, sq          )) & Bitboard256(bbOf(Pawn  )))
+		 | (Bitboard256(attacksFrom<Lance >(Black, sq, occupied), attacksFrom<Lance >(White, sq, occupied)) & Bitboard256(bbOf(Lance )))
+		 | (Bitboard256(attacksFrom<Knight>(Black, sq          ), attacksFrom<Knight>(White, sq          )) & Bitboard256(bbOf(Knight)))
+		 | (Bitboard256(attacksFrom<Silver>(Black, sq          ), attacksFrom<Silver>(White, sq          )) & Bitboard256(bbOf(Silver)))
+		 | (Bitboard256(attacksFrom<Gold  >(Black, sq          ), attacksFrom<Gold  >(White, sq          )) & Bitboard256(goldsBB())))
+		& Bitboard256(bbOf(White), bbOf(Black));
+	const Bitboard256 sliders =
+		Bitboard256(attacksFrom<Bishop>(sq, occupied), attacksFrom<Rook>(sq, occupied))
+		& Bitboard256(bbOf(Bishop, Horse), bbOf(Rook, Dragon));
+	return (stepAttackers | sliders).merge()
 		| (attacksFrom<King  >(sq          ) & bbOf(King  , Horse, Dragon));
 }
 
 // occupied を Position::occupiedBB() 以外のものを使用する場合に使用する。
 Bitboard Position::attackersTo(const Color c, const Square sq, const Bitboard& occupied) const {
 	const Color opposite = oppositeColor(c);
-	return ((attacksFrom<Pawn  >(opposite, sq          ) & bbOf(Pawn  ))
-			| (attacksFrom<Lance >(opposite, sq, occupied) & bbOf(Lance ))
-			| (attacksFrom<Knight>(opposite, sq          ) & bbOf(Knight))
-			| (attacksFrom<Silver>(opposite, sq          ) & bbOf(Silver, King, Dragon))
-			| (attacksFrom<Gold  >(opposite, sq          ) & (bbOf(King  , Horse) | goldsBB()))
-			| (attacksFrom<Bishop>(          sq, occupied) & bbOf(Bishop, Horse        ))
+	// 2 種類の駒の利きを組にして同時に計算する。
+	const Bitboard256 attackers =
+		(Bitboard256(attacksFrom<Pawn  >(opposite, sq          ), attacksFrom<Lance >(opposite, sq, occupied))
+		 & Bitboard256(bbOf(Pawn  ), bbOf(Lance )))
+		| (Bitboard256(attacksFrom<Knight>(opposite, sq          ), attacksFrom<Silver>(opposite, sq          ))
+		   & Bitboard256(bbOf(Knight), bbOf(Silver, King, Dragon)))
+		| (Bitboard256(attacksFrom<Gold  >(opposite, sq          ), attacksFrom<Bishop>(          sq, occupied))
+		   & Bitboard256(bbOf(King  , Horse) | goldsBB(), bbOf(Bishop, Horse)));
+	return (attackers.merge()
 			| (attacksFrom<Rook  >(          sq, occupied) & bbOf(Rook  , Dragon       )))
 		& bbOf(c);
 }
@@ -1922,12 +2480,14 @@ Bitboard Position::attackersTo(const Color c, const Square sq, const Bitboard& o
 // 玉以外で sq へ移動可能な c 側の駒の Bitboard を返す。
 Bitboard Position::attackersToExceptKing(const Color c, const Square sq) const {
 	const Color opposite = oppositeColor(c);
-	return ((attacksFrom<Pawn  >(opposite, sq) & bbOf(Pawn  ))
-			| (attacksFrom<Lance >(opposite, sq) & bbOf(Lance ))
-			| (attacksFrom<Knight>(opposite, sq) & bbOf(Knight))
-			| (attacksFrom<Silver>(opposite, sq) & bbOf(Silver, Dragon))
-			| (attacksFrom<Gold  >(opposite, sq) & (goldsBB() | bbOf(Horse)))
-			| (attacksFrom<Bishop>(          sq) & bbOf(Bishop, Horse ))
+	const Bitboard256 attackers =
+		(Bitboard256(attacksFrom<Pawn  >(opposite, sq), attacksFrom<Lance >(opposite, sq))
+		 & Bitboard256(bbOf(Pawn  ), bbOf(Lance )))
+		| (Bitboard256(attacksFrom<Knight>(opposite, sq), attacksFrom<Silver>(opposite, sq))
+		   & Bitboard256(bbOf(Knight), bbOf(Silver, Dragon)))
+		| (Bitboard256(attacksFrom<Gold  >(opposite, sq), attacksFrom<Bishop>(          sq))
+		   & Bitboard256(goldsBB() | bbOf(Horse), bbOf(Bishop, Horse )));
+	return (attackers.merge()
 			| (attacksFrom<Rook  >(          sq) & bbOf(Rook  , Dragon)))
 		& bbOf(c);
 }
@@ -39,12 +39,37 @@ struct ChangedLists {
 	size_t size;
 };
 
+// 局面を 256bit に詰めたもの。やねうら王の PackedSfen と同じ形式。
+// 手番 1bit、玉の位置 7bit x 2 の後に、玉以外の盤上の駒と持ち駒をハフマン符号で詰める。
+// 全ての駒 (40枚) が盤上か持ち駒にある局面のみ表せる。手数は含まない。
+struct PackedPosition {
+	u8 data[32];
+};
+
+#if defined USE_COPY_MAKE
+// copy-make で、指し手を指す前に退避しておく盤面。undoMove() ではこれを書き戻すだけにする。
+struct BoardSnapshot {
+	Bitboard byTypeBB[PieceTypeNum];
+	Bitboard byColorBB[ColorNum];
+	Bitboard goldsBB;
+	Piece piece[SquareNum];
+	Square kingSquare[ColorNum];
+	Hand hand[ColorNum];
+	EvalList evalList;
+};
+#endif
+
 struct StateInfo {
     // Copied when making a move
     Score material; // stocfish の npMaterial は 先手、後手の点数を配列で持っているけど、
                     // 特に分ける必要は無い気がする。
     int pliesFromNull;
     int continuousCheck[ColorNum]; // Stockfish には無い。
+#if defined USE_ATTACK_COUNTS
+    // 各マスへの先手、後手それぞれの利きの数。玉の利きも数える。
+    // AVX2 で 32 マスずつ足し引きする為に、81 マスを 96 byte に切り上げて持つ。
+    alignas(32) u8 attackCount[ColorNum][96];
+#endif
 
     // Not copied when making a move (will be recomputed anyhow)
     Key boardKey;
@@ -56,6 +81,9 @@ struct StateInfo {
     StateInfo* previous;
     Hand hand; // 手番側の持ち駒
     ChangedLists cl;
+#if defined USE_COPY_MAKE
+    BoardSnapshot board; // この局面になる前の盤面
+#endif
 
     Key key() const { return boardKey + handKey; }
 
@@ -87,6 +115,12 @@ public:
 
 	Position& operator = (const Position& pos);
 	void set(const std::string& sfen, Thread* th);
+	// 詰めた局面から、文字列を介さずに局面を作る。手数は手数の無い SFEN と同じ扱い。
+	// 壊れたデータ (玉の位置が不正、駒が 40 枚より多い、256bit で終わらない) なら false を返し、局面は不定になる。
+	bool setFromPacked(const PackedPosition& pp, Thread* th);
+	// 局面を詰める。駒が 40 枚揃っていなければ false を返す。
+	bool pack(PackedPosition& pp) const;
+	std::string toSFEN() const;
 
 	Bitboard bbOf(const PieceType pt) const                                            { return byTypeBB_[pt]; }
 	Bitboard bbOf(const Color c) const                                                 { return byColorBB_[c]; }
@@ -165,12 +199,19 @@ public:
 	Bitboard attackersTo(const Color c, const Square sq) const { return attackersTo(c, sq, occupiedBB()); }
 	Bitboard attackersTo(const Color c, const Square sq, const Bitboard& occupied) const;
 	Bitboard attackersToExceptKing(const Color c, const Square sq) const;
-	// todo: 利きをデータとして持ったとき、attackersToIsAny() を高速化すること。
+#if defined USE_ATTACK_COUNTS
+	// sq への c 側の駒の利きの数。doMove() で差分更新したもの。
+	int attackCount(const Color c, const Square sq) const { return st_->attackCount[c][sq]; }
+	// 利き数を見るので、xorBBs() などで盤面を一時的に書き換えている間は使わないこと。
+	bool attackersToIsAny(const Color c, const Square sq) const { return attackCount(c, sq) != 0; }
+#else
 	bool attackersToIsAny(const Color c, const Square sq) const { return attackersTo(c, sq).isAny(); }
+#endif
 	bool attackersToIsAny(const Color c, const Square sq, const Bitboard& occupied) const {
 		return attackersTo(c, sq, occupied).isAny();
 	}
 	// 移動王手が味方の利きに支えられているか。false なら相手玉で取れば詰まない。
+	// 動かす駒を盤面から除いた状態で呼ぶので、利き数は使えない。
 	bool unDropCheckIsSupported(const Color c, const Square sq) const { return attackersTo(c, sq).isAny(); }
 	// 利きの生成
 
@@ -219,11 +260,19 @@ public:
 	void doMove(const Move move, StateInfo& newSt, const CheckInfo& ci, const bool moveIsCheck);
 	void undoMove(const Move move);
 	template <bool DO> void doNullMove(StateInfo& backUpSt);
+#if defined USE_MOVEPICKER_PREFETCH
+	// move を指した後の局面の key。
+	Key keyAfter(const Move move) const;
+	// move を指す前に、指した後の局面で使う置換表、評価値のハッシュ、NNUE の重みを読み込み始めておく。
+	void prefetchChild(const Move move) const;
+#endif
 
 	bool seeGe(Move m, Score threshold) const;
 
 	template <Color US> Move mateMoveIn1Ply();
 	Move mateMoveIn1Ply();
+	// 3手詰めなら初手を返す。1手詰めが無いことは呼び出し側で調べておくこと。
+	Move mateMoveIn3Ply();
 
 	Ply gamePly() const         { return gamePly_; }
 
@@ -240,6 +289,8 @@ public:
 	u64 nodesSearched() const          { return nodes_; }
 	void setNodesSearched(const u64 n) { nodes_ = n; }
 	RepetitionType isDraw(const int checkMaxPly = std::numeric_limits<int>::max()) const;
+	// 手番側が 1 手で過去の局面に戻せて、千日手の評価値以上が得られるなら true
+	bool hasUpcomingRepetition(const int checkMaxPly) const;
 
 	Thread* thisThread() const { return thisThread_; }
 
@@ -291,6 +342,28 @@ public:
 
 private:
 	void clear();
+	// 盤上の駒、持ち駒、手番を置いた後で、key や evalList などの局面の情報を作る。
+	void initState(Thread* th);
+#if defined USE_COPY_MAKE
+	void saveBoard(BoardSnapshot& b) const {
+		memcpy(b.byTypeBB, byTypeBB_, sizeof(byTypeBB_));
+		memcpy(b.byColorBB, byColorBB_, sizeof(byColorBB_));
+		b.goldsBB = goldsBB_;
+		memcpy(b.piece, piece_, sizeof(piece_));
+		memcpy(b.kingSquare, kingSquare_, sizeof(kingSquare_));
+		memcpy(b.hand, hand_, sizeof(hand_));
+		b.evalList = evalList_;
+	}
+	void restoreBoard(const BoardSnapshot& b) {
+		memcpy(byTypeBB_, b.byTypeBB, sizeof(byTypeBB_));
+		memcpy(byColorBB_, b.byColorBB, sizeof(byColorBB_));
+		goldsBB_ = b.goldsBB;
+		memcpy(piece_, b.piece, sizeof(piece_));
+		memcpy(kingSquare_, b.kingSquare, sizeof(kingSquare_));
+		memcpy(hand_, b.hand, sizeof(hand_));
+		evalList_ = b.evalList;
+	}
+#endif
 	void setPiece(const Piece piece, const Square sq) {
 		const Color c = pieceToColor(piece);
 		const PieceType pt = pieceToPieceType(piece);
@@ -314,6 +387,12 @@ private:
 	void findCheckers() { st_->checkersBB = attackersToExceptKing(oppositeColor(turn()), kingSquare(turn())); }
 
 	Score computeMaterial() const;
+#if defined USE_ATTACK_COUNTS
+	// 利き数を盤面から全て数え直す。
+	void computeAttackCounts(u8 attackCount[ColorNum][96]) const;
+	// doMove() で盤面を更新した後、動かす前の occupied を使って利き数を差分更新する。
+	void updateAttackCounts(const Move move, const Bitboard& prevOccupied);
+#endif
 
 	void xorBBs(const PieceType pt, const Square sq, const Color c);
 	// turn() 側が
@@ -332,7 +411,7 @@ private:
 
 		// 障害物が無ければ玉に到達出来る駒のBitboardだけ残す。
 		pinners &= (bbOf(Lance) & lanceAttackToEdge((FindPinned ? us : them), ksq)) |
-			(bbOf(Rook, Dragon) & rookAttackToEdge(ksq)) | (bbOf(Bishop, Horse) & bishopAttackToEdge(ksq));
+			(Bitboard256(bbOf(Rook, Dragon), bbOf(Bishop, Horse)) & Bitboard256(rookAttackToEdge(ksq), bishopAttackToEdge(ksq))).merge();
 
 		while (pinners) {
 			const Square sq = pinners.firstOneFromSQ11();
@@ -362,6 +441,27 @@ private:
 
 	void printHand(const Color c) const;
 
+	// boardKeyCount_ の index。手番の bit も含めて下位 bit を使う。
+	static int boardKeyCountIndex(const Key key) { return static_cast<int>(key & (BoardKeyCountSize - 1)); }
+	void incBoardKeyCount(const Key key) { ++boardKeyCount_[boardKeyCountIndex(key)]; }
+	void decBoardKeyCount(const Key key) { --boardKeyCount_[boardKeyCountIndex(key)]; }
+
+	// cuckoo table の要素は、駒の移動を from, to, 駒種, 手番 で 19bit に詰めたもの。0 は空き。
+	static u32 cuckooMove(const Square from, const Square to, const PieceType pt, const Color c) {
+		return static_cast<u32>(from) | (static_cast<u32>(to) << 7) | (static_cast<u32>(pt) << 14) | (static_cast<u32>(c) << 18);
+	}
+	static Square cuckooFrom(const u32 m)       { return static_cast<Square>(m & 0x7f); }
+	static Square cuckooTo(const u32 m)         { return static_cast<Square>((m >> 7) & 0x7f); }
+	static PieceType cuckooPieceType(const u32 m) { return static_cast<PieceType>((m >> 14) & 0xf); }
+	static Color cuckooColor(const u32 m)       { return static_cast<Color>(m >> 18); }
+	// 駒を動かしたときの boardKey の差分。(手番の bit は除く)
+	static Key cuckooKey(const u32 m) {
+		return zobrist(cuckooPieceType(m), cuckooTo(m), cuckooColor(m)) - zobrist(cuckooPieceType(m), cuckooFrom(m), cuckooColor(m));
+	}
+	// zobrist の 1 bit目は使わないので、2 bit目から使う。
+	static int cuckooH1(const Key key) { return static_cast<int>((key >>  1) & (CuckooSize - 1)); }
+	static int cuckooH2(const Key key) { return static_cast<int>((key >> 17) & (CuckooSize - 1)); }
+
 	static Key zobrist(const PieceType pt, const Square sq, const Color c) { return zobrist_[pt][sq][c]; }
 	static Key zobTurn()                                                   { return zobTurn_; }
 	static Key zobHand(const HandPiece hp, const Color c)                  { return zobHand_[hp][c]; }
@@ -389,12 +489,24 @@ private:
 	Thread* thisThread_;
 	u64 nodes_;
 
+	// 対局の履歴と探索中の手順に現れた局面の boardKey を、下位 bit で分けて数えたもの。
+	// 今の局面の数が 1 (自分だけ) なら、同じ盤面は過去に無いので isDraw() で StateInfo を辿らなくて良い。
+	// Position はスレッド毎に持つので、スレッド毎の表になる。
+	// 長い対局で 1 つの要素に局面が集まっても溢れないように 32bit で数える。
+	static const int BoardKeyCountSize = 4096;
+	u32 boardKeyCount_[BoardKeyCountSize];
+
 	//Searcher* searcher_;
 
 	static Key zobrist_[PieceTypeNum][SquareNum][ColorNum];
 	static const Key zobTurn_ = 1;
 	static Key zobHand_[HandPieceNum][ColorNum];
 	static Key zobExclusion_; // todo: これが必要か、要検討
+
+	// 1 手の駒の移動による boardKey の差分から、その移動を引く為の cuckoo hash。(Stockfish の has_game_cycle() と同じ方法)
+	// 成り、駒取り、駒打ちは局面を戻せないので入れない。前にしか進めない歩、香車、桂馬も入れない。
+	static const int CuckooSize = 0x10000;
+	static u32 cuckoo_[CuckooSize];
 };
 
 template <> inline Bitboard Position::attacksFrom<Lance >(const Color c, const Square sq, const Bitboard& occupied) { return  lanceAttack(c, sq, occupied); }
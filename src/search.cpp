@@ -59,6 +59,21 @@ namespace {
     // Threshold used for countermoves based pruning.
     const int CounterMovePruneThreshold = 0;
 
+#if defined USE_MATE_3PLY
+	// 3手詰めを調べる残り深さの上限
+	const Depth Mate3PlyDepth = 1 * OnePly;
+
+	Move mateMoveIn3Ply(Position& pos) {
+		Thread* th = pos.thisThread();
+		const u64 nodes = pos.nodesSearched();
+		const Move move = pos.mateMoveIn3Ply();
+		++th->mate3Probes;
+		th->mate3Hits += (move != MOVE_NONE);
+		th->mate3Nodes += pos.nodesSearched() - nodes;
+		return move;
+	}
+#endif
+
 	constexpr int futility_move_count(bool improving, int depth) {
 		int d = depth / OnePly;
 		return (4 + d * d) / (2 - improving);
@@ -162,6 +177,177 @@ namespace {
     };
 
     EasyMoveManager EasyMove;
+
+	// 並列 MultiPV
+	// スレッドを groups 個のグループに分け、グループ g のスレッドは pvIdx = g, g + groups, ... の PV だけを探索する。
+	// 各グループの結果はここに集め、PV を探索する度に rootMoves をこの順位で並べ直すことで、
+	// 上位の PV の指し手を下位の PV の探索から除く。置換表は全スレッドで共有している。
+	struct ParallelMultiPV {
+
+		struct Entry {
+			RootMove rm;
+			Depth depth;   // この点数と PV を得た探索深さ。まだ探索していなければ Depth0
+			int assigned;  // この指し手を pvIdx の先頭として探索しているスレッドの数
+		};
+
+		void init(const RootMoves& rms, const size_t g) {
+			entries.clear();
+			for (const RootMove& rm : rms)
+				entries.push_back(Entry{rm, Depth0, 0});
+			groups = g;
+		}
+
+		bool enabled() const { return groups > 1; }
+
+		// 点数の降順に並べた表を返す。点数を上限で抑えた指し手は最善手と同じ点数になるので、同じ点数なら深く探索した方を上にする。
+		// それも同じなら init() の順なので、どのスレッドでも同じ順位になる。
+		std::vector<Entry> sorted() {
+			std::lock_guard<Mutex> lk(mutex);
+			return sortedNoLock();
+		}
+
+		// 集めた点数と PV で rms を並べ直す。
+		void sync(RootMoves& rms) {
+			std::lock_guard<Mutex> lk(mutex);
+			copyTo(sortedNoLock(), rms);
+		}
+
+		// rms を共有の順位で並べ直し、rms[pvIdx] に他のスレッドが探索していない指し手を割り当てる。
+		// rms[0..pvIdx) は上位の PV の指し手なので探索しない。割り当てた指し手を返す。
+		Move assign(RootMoves& rms, const size_t pvIdx) {
+			std::lock_guard<Mutex> lk(mutex);
+			std::vector<Entry> es = sortedNoLock();
+			for (size_t i = pvIdx; i < es.size(); ++i) {
+				if (find(es[i].rm.pv[0]).assigned == 0) {
+					std::rotate(es.begin() + pvIdx, es.begin() + i, es.begin() + i + 1);
+					break;
+				}
+			}
+			copyTo(es, rms);
+			for (RootMove& rm : rms)
+				rm.previousScore = rm.score;
+			const Move move = rms[pvIdx].pv[0];
+			++find(move).assigned;
+			return move;
+		}
+
+		// assign() で割り当てた指し手の探索を終えた。completed なら rms[pvIdx..] の結果を書き込む。
+		// 残りの指し手はその最善手の点数以下だと分かったので点数を上限で抑えるが、
+		// 他のスレッドが探索中の指し手や、より深く探索した指し手はそのままにする。
+		void finish(const RootMoves& rms, const size_t pvIdx, const Move assigned, const Depth depth, const bool completed) {
+			std::lock_guard<Mutex> lk(mutex);
+			--find(assigned).assigned;
+			if (!completed)
+				return;
+			const Score bestScore = rms[pvIdx].score;
+			for (size_t i = pvIdx; i < rms.size(); ++i) {
+				Entry& e = find(rms[i].pv[0]);
+				if (i == pvIdx) {
+					e.rm.score = bestScore;
+					e.rm.pv = rms[i].pv;
+					e.depth = depth;
+				}
+				else if (e.assigned == 0 && e.depth <= depth)
+					e.rm.score = std::min(e.rm.score, bestScore);
+			}
+		}
+
+		Mutex mutex;
+		std::vector<Entry> entries;
+		size_t groups;
+
+	private:
+		Entry& find(const Move move) {
+			return *std::find_if(entries.begin(), entries.end(), [&](const Entry& e) { return e.rm.pv[0] == move; });
+		}
+		std::vector<Entry> sortedNoLock() const {
+			std::vector<Entry> es = entries;
+			std::stable_sort(es.begin(), es.end(), [](const Entry& lhs, const Entry& rhs) {
+				return lhs.rm.score != rhs.rm.score ? lhs.rm < rhs.rm : rhs.depth < lhs.depth;
+			});
+			return es;
+		}
+		static void copyTo(const std::vector<Entry>& es, RootMoves& rms) {
+			for (size_t i = 0; i < es.size(); ++i)
+				rms[i] = es[i].rm;
+		}
+	};
+
+	ParallelMultiPV ParallelPV;
+
+	// 持ち時間の上限(Time.maximum())と movetime(秒読み)の期限まで眠り、期限が来たら Signals.stop を立てるスレッド。
+	// 探索スレッドは時刻を調べず、Signals.stop だけを見ればよい。
+	// node 数で制限するとき(nodes, nodes as time)は、これまで通り探索スレッドが checkTime() で調べる。
+	class TimerThread {
+	public:
+		void start() {
+			exit = false;
+			nativeThread = std::thread(&TimerThread::loop, this);
+		}
+
+		void stop() {
+			if (!nativeThread.joinable())
+				return;
+			{
+				std::lock_guard<Mutex> lk(mutex);
+				exit = true;
+			}
+			sleepCondition.notify_one();
+			nativeThread.join();
+		}
+
+		// ponderhit で Limits.ponder と movetime を変えた後に呼び、期限を計算し直させる。
+		void wake() {
+			// loop() が Limits.ponder を調べてから待ち始めるまでの間に通知しないように、一度 mutex を取る。
+			{ std::lock_guard<Mutex> lk(mutex); }
+			sleepCondition.notify_one();
+		}
+
+	private:
+		void loop() {
+			std::unique_lock<Mutex> lk(mutex);
+			while (!exit && !Signals.stop) {
+				// ponder 中は時間切れにならないので、ponderhit で wake() されるまで眠る。
+				if (Limits.ponder) {
+					sleepCondition.wait(lk, [&] { return exit || !Limits.ponder; });
+					continue;
+				}
+
+				int limit = std::numeric_limits<int>::max();
+				if (Limits.useTimeManagement() && !Limits.npmsec)
+					limit = Time.maximum() - 10;
+				if (Limits.moveTime)
+					limit = std::min(limit, Limits.moveTime);
+				if (limit == std::numeric_limits<int>::max()) {
+					sleepCondition.wait(lk, [&] { return exit; });
+					break;
+				}
+
+				const int remaining = limit - Time.elapsed();
+				if (remaining <= 0) {
+					Signals.stop = true;
+					break;
+				}
+				// ponderhit で movetime が変わることがあるので、起きたら期限を計算し直す。
+				sleepCondition.wait_for(lk, std::chrono::milliseconds(std::min(remaining, 100)));
+			}
+		}
+
+		Mutex mutex;
+		ConditionVariable sleepCondition;
+		bool exit;
+		std::thread nativeThread;
+	};
+
+	TimerThread StopTimer;
+	// node 数で制限するときだけ、探索中に checkTime() を呼ぶ。
+	bool PollLimits;
+
+#if defined USE_SEARCH_STATS
+#define SEARCH_STATS_INC(x) (++thisThread->stats.x)
+#else
+#define SEARCH_STATS_INC(x) ((void)0)
+#endif
 	Score DrawScore[ColorNum];
 
     template <NodeType NT>
@@ -427,6 +613,43 @@ std::string pvInfoToUSI(Position& pos, const Depth depth, const Score alpha, con
 	}
 	return ss.str();
 }
+
+// 並列 MultiPV のとき、全てのグループの PV をまとめて出力する。
+// グループ毎に反復深化の深さが違うので、各 PV はそれを探索した深さで出力する。
+std::string parallelPvInfoToUSI(Position& pos) {
+	std::stringstream ss;
+	const int t = Time.elapsed() + 1;
+	const std::vector<ParallelMultiPV::Entry> entries = ParallelPV.sorted();
+	const size_t multiPV = std::min((size_t)Options["MultiPV"], entries.size());
+	const uint64_t nodesSearched = Threads.nodes_searched();
+
+	for (size_t i = multiPV - 1; 0 <= static_cast<int>(i); --i) {
+		if (entries[i].depth == Depth0)
+			continue;
+
+		if (ss.rdbuf()->in_avail()) // Not at first line
+			ss << "\n";
+
+		ss << "info depth " << entries[i].depth / OnePly
+		   << " seldepth " << pos.thisThread()->maxPly
+		   << " multipv " << i + 1
+		   << " score " << scoreToUSI(entries[i].rm.score)
+		   << " nodes " << nodesSearched
+		   << " nps " << nodesSearched * 1000 / t;
+
+		if (t > 1000) // Earlier makes little sense
+			ss << " hashfull " << TT.hashfull();
+
+		ss << " time " << t
+		   << " pv";
+
+		for (Move m : entries[i].rm.pv)
+			ss << " " << m.toUSI();
+
+		ss << std::endl;
+	}
+	return ss.str();
+}
 } // namespace
 
 void Search::init() {
@@ -439,31 +662,48 @@ void Search::clear() {
 
 	TT.clear();
 
+	// スレッドごとの history はスレッド数に比例して大きくなるので、並列に初期化する。
+	// 探索スレッドと同じ NUMA node に割り当てられるように、スレッドの番号で bind しておく。
+	std::vector<std::thread> clearThreads;
 	for (Thread* th : Threads)
-	{
-		th->resetCalls = true;
+		clearThreads.emplace_back([th] {
+			WinProcGroup::bindThisThread(th->idx);
+			th->clear();
+		});
+	for (std::thread& t : clearThreads)
+		t.join();
 
-		th->nmpMinPly = 0;
+	Threads.main()->previousScore = ScoreInfinite;
+}
 
-		th->counterMoves.fill(MOVE_NONE);
-		th->mainHistory.fill(0);
-		th->lowPlyHistory.fill(0);
-		th->captureHistory.fill(0);
+void Search::ponderhit() {
+	StopTimer.wake();
+}
 
-		// ここは、未初期化のときに[SQ_ZERO][NO_PIECE]を指すので、ここを-1で初期化しておくことによって、
-		// history > 0 を条件にすれば自ずと未初期化のときは除外されるようになる。
-		for (bool inCheck : { false, true })
-			for (StatsType c : { NoCaptures, Captures })
-			{
-				for (auto& to : th->continuationHistory[inCheck][c])
-					for (auto& h : to)
-						h->fill(0);
-				th->continuationHistory[inCheck][c][SQ_ZERO][NO_PIECE]->fill(Search::CounterMovePruneThreshold - 1);
-			}
-	}
+#if defined USE_SEARCH_STATS
+std::string Search::searchStatsToString() {
+	SearchStats total;
+	for (Thread* th : Threads)
+		total += th->stats;
 
-	Threads.main()->previousScore = ScoreInfinite;
+	auto rate = [](const uint64_t n, const uint64_t d) { return (d ? 100.0 * n / d : 0.0); };
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision(1)
+	   << "stats nodes " << total.nodes << " tt_cutoff " << rate(total.ttCutoffs, total.nodes) << "%\n"
+	   << "stats beta_cutoff " << total.betaCutoffs << " first_move " << rate(total.firstMoveCutoffs, total.betaCutoffs) << "%\n"
+	   << "stats lmr " << total.lmrSearches << " research " << rate(total.lmrResearches, total.lmrSearches) << "%\n"
+	   << "stats null_move " << total.nullMoveTries << " cutoff " << rate(total.nullMoveCutoffs, total.nullMoveTries) << "%\n"
+	   << "stats probcut " << total.probCutTries << " cutoff " << rate(total.probCutCutoffs, total.probCutTries) << "%\n"
+	   << "stats singular " << total.singularTests << " extension " << rate(total.singularExtensions, total.singularTests) << "%"
+	   << " multicut " << rate(total.multiCuts, total.singularTests) << "%\n"
+	   << std::setprecision(2) << "stats ebf";
+	// 深さ d の反復を終えるまでの node 数と深さ d - 1 までの node 数の比
+	const std::vector<uint64_t>& iterationNodes = Threads.main()->stats.iterationNodes;
+	for (size_t i = 1; i < iterationNodes.size(); ++i)
+		ss << " " << i + 1 << ":" << (iterationNodes[i - 1] ? double(iterationNodes[i]) / iterationNodes[i - 1] : 0.0);
+	return ss.str();
 }
+#endif
 
 // 入玉勝ちかどうかを判定
 bool nyugyoku(const Position& pos) {
@@ -524,6 +764,7 @@ void MainThread::search() {
 	std::uniform_int_distribution<int> dist(Options["Min_Book_Ply"], Options["Max_Book_Ply"]);
 	const Ply book_ply = dist(g_randomTimeSeed);
 	bool nyugyokuWin = false;
+	ParallelPV.init(rootMoves, 1); // 探索せずに指すときは並列 MultiPV の結果を使わない。
 
 	int contempt = Options["Contempt"] * PawnScore / 100; // From centipawns
 	DrawScore[us] = ScoreDraw - Score(contempt);
@@ -596,18 +837,27 @@ void MainThread::search() {
 	detectInaniwa(pos);
 #endif
 
-    for (Thread* th : Threads)
+    PollLimits = (Limits.nodes || Limits.npmsec);
+
     {
-      th->maxPly = 0;
-      th->rootDepth = Depth0;
-      if (th != this)
-      {
-        //th->nmp_ply = th->nmp_odd = 0;
-        th->rootPos = Position(rootPos, th);
-        th->rootMoves = rootMoves;
-        th->start_searching();
-      }
+      const size_t multiPV = std::min((size_t)Options["MultiPV"], rootMoves.size());
+      const bool parallel = Options["Parallel_MultiPV"] && !Skill(Options["Skill_Level"]).enabled();
+      ParallelPV.init(rootMoves, parallel ? std::min(multiPV, Threads.size()) : 1);
+    }
+
+    maxPly = 0;
+    rootDepth = Depth0;
+    Threads.startHelpers(rootPos, rootMoves);
+
+    if (Threads.mateThread) {
+      Threads.mateThread->rootPos = Position(rootPos, Threads.mateThread);
+      Threads.mateThread->start_searching();
     }
+
+    StopTimer.start();
+#endif
+#if defined USE_SEARCH_STATS
+    searchStartTime = std::chrono::steady_clock::now();
 #endif
     Thread::search(); // Let's start searching!
 
@@ -623,10 +873,24 @@ finalize:
 		wait(Signals.stop);
 	}
 
+	// 詰み探索スレッドは自分では止まらないので、ここで全スレッドを止める。
+	Signals.stop = true;
+	StopTimer.stop();
+
+#if defined USE_SEARCH_STATS
+	const auto stopTime = std::chrono::steady_clock::now();
+#endif
+
     // Wait until all threads have finished
-	for (Thread* th : Threads)
-		if (th != this)
-			th->wait_for_search_finished();
+	Threads.waitForHelpers();
+	if (Threads.mateThread)
+		Threads.mateThread->wait_for_search_finished();
+
+	// main thread より後に終わったグループの結果も bestmove と最後の PV に入れる。
+	if (ParallelPV.enabled()) {
+		ParallelPV.sync(rootMoves);
+		SYNCCOUT << parallelPvInfoToUSI(rootPos) << SYNCENDL;
+	}
 
     // Check if there are threads with a better score than main thread
     Thread* bestThread = this;
@@ -661,11 +925,34 @@ finalize:
 		}
 	}
 
+	if (!isbook && !nyugyokuWin)
+		Time.writeLog(bestThread->rootMoves[0].pv[0], previousScore, rootMoves.size());
+
     previousScore = bestThread->rootMoves[0].score;
 
     if (bestThread != this)
         SYNCCOUT << pvInfoToUSI(bestThread->rootPos, bestThread->completedDepth, -ScoreInfinite, ScoreInfinite) << SYNCENDL;
 
+#if defined USE_SEARCH_STATS
+	if (!isbook) {
+		std::istringstream is(Search::searchStatsToString());
+		std::string line;
+		while (std::getline(is, line))
+			SYNCCOUT << "info string " << line << SYNCENDL;
+
+		// go から各スレッドが探索を始めるまでと、探索を止めてから bestmove を返すまでの時間[us]
+		auto us = [](const std::chrono::steady_clock::duration d) {
+			return (long long)std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+		};
+		auto lastStart = searchStartTime;
+		for (Thread* th : Threads)
+			lastStart = std::max(lastStart, th->searchStartTime);
+		SYNCCOUT << "info string stats latency go_to_search " << us(searchStartTime - Threads.goTime)
+				 << " last_helper " << us(lastStart - Threads.goTime)
+				 << " stop_to_bestmove " << us(std::chrono::steady_clock::now() - stopTime) << SYNCENDL;
+	}
+#endif
+
 #ifdef RESIGN
     if (!isbook && previousScore < -Options["Resign"] 
 		&& !Skill(Options["Skill_Level"]).enabled()) // 
@@ -703,6 +990,10 @@ void Thread::search() {
     beta = ScoreInfinite;
     completedDepth = Depth0;
 
+#if defined USE_SEARCH_STATS
+	stats.clear();
+#endif
+
 	if (mainThread)
 	{
 		easyMove = EasyMove.get(rootPos.getKey());
@@ -735,8 +1026,10 @@ void Thread::search() {
 		   && (!Limits.depth || Threads.main()->rootDepth / OnePly <= Limits.depth)) {
 
         // Distribute search depths across the threads
-        if (idx) {
-            int i = (idx - 1) % 20;
+        // 並列 MultiPV のときは、同じ PV を探索するグループの中で分散させる。
+        const size_t helperIdx = (ParallelPV.enabled() ? idx / ParallelPV.groups : idx);
+        if (helperIdx) {
+            int i = (helperIdx - 1) % 20;
             if (((rootDepth / OnePly + rootPos.gamePly() + skipPhase[i]) / skipSize[i]) % 2)
                 continue;
         }
@@ -744,12 +1037,20 @@ void Thread::search() {
 		if (mainThread)
 			mainThread->bestMoveChanges *= 0.505, mainThread->failedLow = false;
 
+		// 他のグループが探索した PV を取り込む。
+		if (ParallelPV.enabled())
+			ParallelPV.sync(rootMoves);
+
 		// 前回の iteration の結果を全てコピー
 		for (RootMove& rm : rootMoves)
 			rm.previousScore = rm.score;
 
 		// Multi PV loop
-		for (pvIdx = 0; pvIdx < multiPV && !Signals.stop; ++pvIdx) {
+		const size_t pvStart = (ParallelPV.enabled() ? idx % ParallelPV.groups : 0);
+		const size_t pvStep  = (ParallelPV.enabled() ? ParallelPV.groups : 1);
+		for (pvIdx = pvStart; pvIdx < multiPV && !Signals.stop; pvIdx += pvStep) {
+			// 他のグループが探索した結果で並べ直し、他のグループと重ならない指し手から探索する。
+			const Move assignedMove = (ParallelPV.enabled() ? ParallelPV.assign(rootMoves, pvIdx) : MOVE_NONE);
 #if defined LEARN
 			alpha = this->alpha;
 			beta = this->beta;
@@ -823,17 +1124,23 @@ void Thread::search() {
 				assert(-ScoreInfinite <= alpha && beta <= ScoreInfinite);
 			}
 
-			std::stable_sort(rootMoves.begin(), rootMoves.begin() + pvIdx + 1);
+			if (ParallelPV.enabled())
+				ParallelPV.finish(rootMoves, pvIdx, assignedMove, rootDepth, !Signals.stop);
+			else
+				std::stable_sort(rootMoves.begin(), rootMoves.begin() + pvIdx + 1);
 
 			if (!mainThread)
 				continue;
 
-			if ((Signals.stop || pvIdx + 1 == multiPV || 3000 < Time.elapsed())
+			if ((Signals.stop || pvIdx + pvStep >= multiPV || 3000 < Time.elapsed())
 			    // 将棋所のコンソールが詰まるのを防ぐ。
 			    && (rootDepth < 4 || lastInfoTime + pv_interval < Time.elapsed()))
 			{
 				lastInfoTime = Time.elapsed();
-				SYNCCOUT << pvInfoToUSI(rootPos, rootDepth, alpha, beta) << SYNCENDL;
+				if (ParallelPV.enabled())
+					SYNCCOUT << parallelPvInfoToUSI(rootPos) << SYNCENDL;
+				else
+					SYNCCOUT << pvInfoToUSI(rootPos, rootDepth, alpha, beta) << SYNCENDL;
 			}
 		}
 
@@ -843,6 +1150,14 @@ void Thread::search() {
 		if (!mainThread)
 			continue;
 
+#if defined USE_SEARCH_STATS
+		if (!Signals.stop)
+			stats.iterationNodes.push_back(Threads.nodes_searched());
+#endif
+
+		if (!Signals.stop)
+			Time.logIteration(rootDepth / OnePly, bestScore, rootMoves[0].pv[0], mainThread->bestMoveChanges, mainThread->failedLow);
+
 		if (skill.enabled() && skill.time_to_pick(rootDepth))
 			skill.pick_best(multiPV);
 
@@ -927,7 +1242,6 @@ Score search(Position& pos, Stack* ss, Score alpha, Score beta, const Depth dept
     assert(depth / OnePly * OnePly == depth);
 
     Move pv[MaxPly+1], quietsSearched[64], capturesSearched[32];
-	StateInfo st;
 	TTEntry* tte;
 	Key posKey;
 	Move ttMove, move, excludedMove, bestMove;
@@ -955,28 +1269,35 @@ Score search(Position& pos, Stack* ss, Score alpha, Score beta, const Depth dept
 	ss->statScore = 0;
     bestScore = -ScoreInfinite;
     ss->ply = (ss-1)->ply + 1;
+	StateInfo& st = thisThread->states[ss->ply];
 	bool priorCapture = (pos.captured_piece() != Empty);
 	Color us = pos.turn();
 
-    if (thisThread->resetCalls.load(std::memory_order_relaxed))
-    {
-        thisThread->resetCalls = false;
-		// At low node count increase the checking rate to about 0.1% of nodes
-		// otherwise use a default value.
-		thisThread->callsCnt = Limits.nodes ? std::min(4096, int(Limits.nodes / 1024))
-			                                : 4096;
-    }
-    if (--thisThread->callsCnt <= 0)
-    {
-        for (Thread* th : Threads)
-            th->resetCalls = true;
+	// 時間切れは TimerThread が Signals.stop を立てるので、ここでは node 数の制限だけを調べる。
+	if (PollLimits)
+	{
+		if (thisThread->resetCalls.load(std::memory_order_relaxed))
+		{
+			thisThread->resetCalls = false;
+			// At low node count increase the checking rate to about 0.1% of nodes
+			// otherwise use a default value.
+			thisThread->callsCnt = Limits.nodes ? std::min(4096, int(Limits.nodes / 1024))
+				                                : 4096;
+		}
+		if (--thisThread->callsCnt <= 0)
+		{
+			for (Thread* th : Threads)
+				th->resetCalls = true;
 
-        checkTime();
-    }
+			checkTime();
+		}
+	}
 
 	if (PvNode && thisThread->maxPly < ss->ply)
 		thisThread->maxPly = ss->ply;
 
+	SEARCH_STATS_INC(nodes);
+
 	if (!rootNode) {
 		// step2
 		// stop と最大探索深さのチェック
@@ -990,6 +1311,15 @@ Score search(Position& pos, Stack* ss, Score alpha, Score beta, const Depth dept
 		default                 : UNREACHABLE;
 		}
 
+#if defined USE_UPCOMING_REPETITION
+		// 1 手で過去の局面に戻せるなら、少なくとも千日手の評価値は得られる。
+		if (alpha < DrawScore[pos.turn()] && pos.hasUpcomingRepetition(16)) {
+			alpha = DrawScore[pos.turn()];
+			if (beta <= alpha)
+				return alpha;
+		}
+#endif
+
 		// step3
 		// mate distance pruning
 		alpha = std::max(matedIn(ss->ply), alpha);
@@ -1056,6 +1386,7 @@ Score search(Position& pos, Stack* ss, Score alpha, Score beta, const Depth dept
 				update_continuation_histories(ss, pos.movedPiece(ttMove), ttMove.to(), penalty);
 			}
 		}
+		SEARCH_STATS_INC(ttCutoffs);
 		return ttScore;
 	}
 
@@ -1072,6 +1403,18 @@ Score search(Position& pos, Stack* ss, Score alpha, Score beta, const Depth dept
 					  move, ss->staticEval, TT.generation());
 			return bestScore;
 		}
+#if defined USE_MATE_3PLY
+		if (!PvNode
+			&& !inCheck
+			&& depth <= Mate3PlyDepth
+			&& (move = mateMoveIn3Ply(pos)) != MOVE_NONE)
+		{
+			ss->staticEval = bestScore = mateIn(ss->ply + 2);
+			tte->save(posKey, scoreToTT(bestScore, ss->ply), ttPv, BoundExact, depth,
+					  move, ss->staticEval, TT.generation());
+			return bestScore;
+		}
+#endif
 	}
 
 	CapturePieceToHistory& captureHistory = thisThread->captureHistory;
@@ -1144,6 +1487,7 @@ Score search(Position& pos, Stack* ss, Score alpha, Score beta, const Depth dept
 
         ss->currentMove = Move::moveNull();
         ss->continuationHistory = &thisThread->continuationHistory[0][0][SQ_ZERO][NO_PIECE];
+		SEARCH_STATS_INC(nullMoveTries);
 
 		pos.doNullMove<true>(st);
 		(ss+1)->staticEvalRaw = (ss)->staticEvalRaw; // 評価値の差分評価の為。
@@ -1156,8 +1500,10 @@ Score search(Position& pos, Stack* ss, Score alpha, Score beta, const Depth dept
 				nullScore = beta;
 
 			//if (abs(beta) < ScoreKnownWin && (depth < 12 * OnePly || thisThread->nmp_ply)) // PARAM_NULL_MOVE_RETURN_DEPTH 12 -> 14 -> 12
-			if (thisThread->nmpMinPly || (abs(beta) < ScoreKnownWin && depth < 13 * OnePly)) // PARAM_NULL_MOVE_RETURN_DEPTH 12 -> 14 -> 12
+			if (thisThread->nmpMinPly || (abs(beta) < ScoreKnownWin && depth < 13 * OnePly)) { // PARAM_NULL_MOVE_RETURN_DEPTH 12 -> 14 -> 12
+				SEARCH_STATS_INC(nullMoveCutoffs);
 				return nullScore;
+			}
 
 			// thisThread->nmp_ply = ss->ply + 3 * (depth-R) / 4;
 			// thisThread->nmp_odd = ss->ply % 2;
@@ -1171,8 +1517,10 @@ Score search(Position& pos, Stack* ss, Score alpha, Score beta, const Depth dept
 			// thisThread->nmp_odd = thisThread->nmp_ply = 0;
 			thisThread->nmpMinPly = 0;
 
-			if (s >= beta)
+			if (s >= beta) {
+				SEARCH_STATS_INC(nullMoveCutoffs);
 				return nullScore;
+			}
 		}
 	}
 
@@ -1204,6 +1552,7 @@ Score search(Position& pos, Stack* ss, Score alpha, Score beta, const Depth dept
 			if (move != excludedMove && pos.pseudoLegalMoveIsLegal<false, false>(move, ci.pinned)) {
 				captureOrPawnPromotion = move.isCapture() /*true*/;
 				probCutCount++;
+				SEARCH_STATS_INC(probCutTries);
 
 				ss->currentMove = move;
 				ss->continuationHistory = &thisThread->continuationHistory[ss->inCheck][captureOrPawnPromotion][move.to()][pos.movedPiece(move)];
@@ -1223,8 +1572,10 @@ Score search(Position& pos, Stack* ss, Score alpha, Score beta, const Depth dept
 
 				pos.undoMove(move);
 
-				if (score >= rbeta)
+				if (score >= rbeta) {
+					SEARCH_STATS_INC(probCutCutoffs);
 					return score;
+				}
 			}
 		}
 	}
@@ -1382,15 +1733,19 @@ moves_loop:
 			ss->excludedMove = move;
 			score = search<NonPV>(pos, ss, singularBeta-1, singularBeta, singularDepth, cutNode);
 			ss->excludedMove = Move::moveNone();
+			SEARCH_STATS_INC(singularTests);
 
 			if (score < singularBeta) {
 				extension = OnePly;
 				singularLMR = true;
+				SEARCH_STATS_INC(singularExtensions);
 			}
 
 			// Multi-cut pruning
-			else if (singularBeta >= beta)
+			else if (singularBeta >= beta) {
+				SEARCH_STATS_INC(multiCuts);
 				return singularBeta;
+			}
 
 			// If the eval of ttMove is greater than beta we try also if there is an other move that
 			// pushes it over beta, if so also produce a cutoff
@@ -1400,8 +1755,10 @@ moves_loop:
 				score = search<NonPV>(pos, ss, beta - 1, beta, (depth + 3 * OnePly) / 2, cutNode);
 				ss->excludedMove = Move::moveNone();
 
-				if (score >= beta)
+				if (score >= beta) {
+					SEARCH_STATS_INC(multiCuts);
 					return beta;
+				}
 			}
 		}
 
@@ -1510,6 +1867,9 @@ moves_loop:
 			// 上の探索によりalphaを更新しそうだが、いい加減な探索なので信頼できない。まともな探索で検証しなおす。
 			doFullDepthSearch = (score > alpha) && (d != newDepth);
 			didLMR = true;
+			SEARCH_STATS_INC(lmrSearches);
+			if (doFullDepthSearch)
+				SEARCH_STATS_INC(lmrResearches);
 		}
 		else
 		{
@@ -1600,6 +1960,9 @@ moves_loop:
 					// fail high
 					assert(score >= beta);
 					ss->statScore = 0;
+					SEARCH_STATS_INC(betaCutoffs);
+					if (moveCount == 1)
+						SEARCH_STATS_INC(firstMoveCutoffs);
 					break;
 				}
 			}
@@ -1652,7 +2015,6 @@ Score qsearch(Position& pos, Stack* ss, Score alpha, Score beta, const Depth dep
     assert(depth / OnePly * OnePly == depth);
 
     Move pv[MaxPly+1];
-	StateInfo st;
 	TTEntry* tte;
 	Key posKey;
 	Move ttMove, move, bestMove;
@@ -1676,6 +2038,8 @@ Score qsearch(Position& pos, Stack* ss, Score alpha, Score beta, const Depth dep
 	if (ss->ply >= MaxPly)
 		return DrawScore[pos.turn()];
 
+	StateInfo& st = thisThread->states[ss->ply];
+
 	assert(0 <= ss->ply && ss->ply < MaxPly);
 
 	ttDepth = ((INCHECK || DepthQChecks <= depth) ? DepthQChecks : DepthQNoChecks);
@@ -1704,6 +2068,11 @@ Score qsearch(Position& pos, Stack* ss, Score alpha, Score beta, const Depth dep
 		if ((move = pos.mateMoveIn1Ply()) != MOVE_NONE)
 			return mateIn(ss->ply);
 
+#if defined USE_MATE_3PLY
+		if (depth == DepthQChecks && (move = mateMoveIn3Ply(pos)) != MOVE_NONE)
+			return mateIn(ss->ply + 2);
+#endif
+
 		if (ttHit) {
 			if ((ss->staticEval = bestScore = tte->evalScore()) == ScoreNone)
 				ss->staticEval = bestScore = evaluate(pos, ss);
@@ -1833,8 +2202,176 @@ void checkTime() {
         || (Limits.nodes && Threads.nodes_searched() >= (uint64_t)Limits.nodes))
             Signals.stop = true;
 }
+
+// 詰み探索スレッド用の、王手の連続だけで詰むかを調べる探索。
+// 攻め方の手番の局面を OR node、受け方の手番の局面を AND node として深さ優先で読む。
+// 返り値は詰みまでの手数で、depth 手以内に詰みが見つからなければ -1 を返す。
+int mateSearchAnd(MateThread* th, Position& pos, const int depth);
+
+bool isDisproven(const MateThread* th, const Key key, const int depth) {
+	const MateThread::DisproofEntry& e = th->disproofTable[key & (MateThread::DisproofTableSize - 1)];
+	return e.key == key && depth <= e.depth;
+}
+
+void setDisproven(MateThread* th, const Key key, const int depth) {
+	MateThread::DisproofEntry& e = th->disproofTable[key & (MateThread::DisproofTableSize - 1)];
+	e.key = key;
+	e.depth = depth;
+}
+
+// 証明済みの詰みは探索深さに依らず正しいので、上書きされにくいように最大の深さで保存する。
+void saveMate(const Key key, const Score s, const Bound b, const Move move) {
+	bool ttHit;
+	TTEntry* tte = TT.probe(key, ttHit);
+	tte->save(key, s, false, b, DepthMax - OnePly, move, ScoreNone, TT.generation());
+}
+
+int mateSearchOr(MateThread* th, Position& pos, const int depth) {
+	// 逆王手を掛けられている局面は読まない。
+	if (Signals.stop || pos.inCheck())
+		return -1;
+
+	const Key key = pos.getKey();
+	if (isDisproven(th, key, depth))
+		return -1;
+
+	const Move mate = pos.mateMoveIn1Ply();
+	if (mate != MOVE_NONE) {
+		saveMate(key, mateIn(1), BoundExact, mate);
+		return 1;
+	}
+
+	if (depth < 3) {
+		setDisproven(th, key, depth);
+		return -1;
+	}
+
+	const uint64_t repetitionCuts = th->repetitionCuts;
+	const CheckInfo ci(pos);
+	StateInfo st;
+	for (MoveList<Check> ml(pos); !ml.end(); ++ml) {
+		const Move move = ml.move();
+		if (!pos.pseudoLegalMoveIsLegal<false, false>(move, ci.pinned))
+			continue;
+
+		pos.doMove(move, st, ci, true);
+		// 連続王手の千日手は攻め方の負けなので、同一局面が現れたら詰みとはしない。
+		int ply = -1;
+		if (pos.isDraw(16) == NotRepetition)
+			ply = mateSearchAnd(th, pos, depth - 1);
+		else
+			++th->repetitionCuts;
+		pos.undoMove(move);
+
+		if (ply >= 0) {
+			// 王手以外の手でもっと短く詰むかもしれないので下限として保存する。
+			if (th->repetitionCuts == repetitionCuts)
+				saveMate(key, mateIn(ply + 1), BoundLower, move);
+			return ply + 1;
+		}
+	}
+
+	if (!Signals.stop && th->repetitionCuts == repetitionCuts)
+		setDisproven(th, key, depth);
+	return -1;
+}
+
+int mateSearchAnd(MateThread* th, Position& pos, const int depth) {
+	// 成れるのに成らない手で逃れることもあるので、受け方の手は全て読む。
+	MoveList<LegalAll> ml(pos);
+	if (ml.size() == 0)
+		return 0;
+
+	const Key key = pos.getKey();
+	if (depth < 2 || Signals.stop || isDisproven(th, key, depth))
+		return -1;
+
+	const uint64_t repetitionCuts = th->repetitionCuts;
+	StateInfo st;
+	int longest = 0;
+	Move longestMove = MOVE_NONE;
+	for (; !ml.end(); ++ml) {
+		const Move move = ml.move();
+		pos.doMove(move, st);
+		int ply = -1;
+		if (pos.isDraw(16) == NotRepetition)
+			ply = mateSearchOr(th, pos, depth - 1);
+		else
+			++th->repetitionCuts;
+		pos.undoMove(move);
+
+		if (ply < 0) {
+			if (!Signals.stop && th->repetitionCuts == repetitionCuts)
+				setDisproven(th, key, depth);
+			return -1;
+		}
+		if (longest < ply + 1) {
+			longest = ply + 1;
+			longestMove = move;
+		}
+	}
+
+	if (th->repetitionCuts == repetitionCuts)
+		saveMate(key, matedIn(longest), BoundUpper, longestMove);
+	return longest;
+}
+
+// 手数を 2 手ずつ伸ばしながら詰みを探す。
+// 王手だけを読んでいるので、見つかった詰みが最短とは限らない。置換表には mateSearchOr() が下限として保存する。
+int huntMate(MateThread* th, Position& pos, const int maxDepth) {
+	for (int depth = 1; depth <= maxDepth && !Signals.stop; depth += 2) {
+		const int ply = mateSearchOr(th, pos, depth);
+		if (ply >= 0)
+			return ply;
+	}
+	return -1;
+}
 } // namespace
 
+// 詰み探索スレッド
+// ルート局面と、置換表から辿った PV 上の局面について、王手の連続で詰むかを手数を伸ばしながら調べる。
+// 詰みを見つけた局面は置換表に詰みの点数を書き込むので、通常探索はそれを使って枝刈り出来る。
+void MateThread::search() {
+	const int maxPly = Options["Mate_Thread_Ply"];
+	const int MaxHuntPvPly = 8;
+	Position& pos = rootPos;
+	StateInfo states[MaxHuntPvPly];
+	Move pv[MaxHuntPvPly];
+
+	// 千日手の判定が手順に依存するので、詰まないと分かった局面の表は探索毎に作り直す。
+	disproofTable.assign(DisproofTableSize, DisproofEntry{0, -1});
+
+	for (int depth = 1; depth <= maxPly && !Signals.stop; depth += 2) {
+		int ply = 0;
+		while (true) {
+			if (!pos.inCheck()) {
+				const int matePly = huntMate(this, pos, depth);
+				if (ply == 0 && matePly >= 0) {
+					SYNCCOUT << "info string mate_thread found mate " << matePly << SYNCENDL;
+					return;
+				}
+			}
+
+			bool ttHit;
+			const TTEntry* tte = TT.probe(pos.getKey(), ttHit);
+			Move move;
+			if (Signals.stop
+				|| ply >= MaxHuntPvPly
+				|| !ttHit
+				|| !tte->move()
+				|| !pos.moveIsPseudoLegal(move = move16toMove(tte->move(), pos))
+				|| !pos.pseudoLegalMoveIsLegal<false, false>(move, pos.pinnedBB()))
+			{
+				break;
+			}
+			pos.doMove(move, states[ply]);
+			pv[ply++] = move;
+		}
+		while (ply)
+			pos.undoMove(pv[--ply]);
+	}
+}
+
 bool RootMove::extractPonderFromTT(Position& pos)
 {
     StateInfo st;
@@ -47,6 +47,44 @@ struct RootMove {
 
 typedef std::vector<RootMove> RootMoves;
 
+#if defined USE_SEARCH_STATS
+// 枝刈りや延長がどのくらい働いているかの統計。スレッドごとに持ち、探索開始時に clear() する。
+struct SearchStats {
+	void clear() { *this = SearchStats(); }
+	SearchStats& operator += (const SearchStats& s) {
+		nodes              += s.nodes;
+		ttCutoffs          += s.ttCutoffs;
+		betaCutoffs        += s.betaCutoffs;
+		firstMoveCutoffs   += s.firstMoveCutoffs;
+		lmrSearches        += s.lmrSearches;
+		lmrResearches      += s.lmrResearches;
+		nullMoveTries      += s.nullMoveTries;
+		nullMoveCutoffs    += s.nullMoveCutoffs;
+		probCutTries       += s.probCutTries;
+		probCutCutoffs     += s.probCutCutoffs;
+		singularTests      += s.singularTests;
+		singularExtensions += s.singularExtensions;
+		multiCuts          += s.multiCuts;
+		return *this;
+	}
+
+	uint64_t nodes = 0;              // 静止探索を除く search() の node 数
+	uint64_t ttCutoffs = 0;          // 置換表の値で返した回数
+	uint64_t betaCutoffs = 0;        // fail high した回数
+	uint64_t firstMoveCutoffs = 0;   // そのうち 1 手目で fail high した回数
+	uint64_t lmrSearches = 0;        // LMR で浅く探索した回数
+	uint64_t lmrResearches = 0;      // そのうち元の深さで探索し直した回数
+	uint64_t nullMoveTries = 0;
+	uint64_t nullMoveCutoffs = 0;
+	uint64_t probCutTries = 0;       // probcut で試した指し手の数
+	uint64_t probCutCutoffs = 0;
+	uint64_t singularTests = 0;      // singular extension の判定のための探索の回数
+	uint64_t singularExtensions = 0;
+	uint64_t multiCuts = 0;
+	std::vector<uint64_t> iterationNodes; // 反復深化の各深さを終えた時点の全スレッドの node 数。main thread だけが使う。
+};
+#endif
+
 // 時間や探索深さの制限を格納する為の構造体
 struct LimitsType {
     LimitsType() {
@@ -84,7 +122,13 @@ struct SignalsType {
 
 	void init();
     void clear();
+	// ponderhit で Limits を変えた後に呼ぶ。
+	void ponderhit();
     Score evaluate(Position& pos, Search::Stack* ss);
+#if defined USE_SEARCH_STATS
+	// 全スレッドの SearchStats を集計した結果。1 行ずつ改行で区切る。
+	std::string searchStatsToString();
+#endif
 
 }; // namespace Search
 
@@ -7,7 +7,13 @@ using namespace Search;
 
 ThreadPool Threads; // Global object
 
-Thread::Thread() {
+namespace {
+	// 起こされるのを待つときに、condition variable で眠る前に空回りする回数
+	// 探索の終了は直ぐに伝わるので、main thread が helper を待つときは眠らずに済むことが多い。
+	const int SpinCount = 1 << 10;
+}
+
+Thread::Thread(bool helper) : isHelper(helper) {
 
   resetCalls = exit = false;
   maxPly = callsCnt = 0;
@@ -28,10 +34,46 @@ Thread::~Thread() {
   exit = true;
   sleepCondition.notify_one();
   mutex.unlock();
+  if (isHelper) {
+    // helper は wakeCondition で待っている。
+    std::lock_guard<Mutex> lk(Threads.wakeMutex);
+    Threads.wakeCondition.notify_all();
+  }
   nativeThread.join();
 }
 
 
+/// Thread::clear() はこのスレッドの history などを初期化する。
+/// Search::clear() から、スレッドごとに並列に呼ばれる。
+
+void Thread::clear() {
+
+  resetCalls = true;
+
+  nmpMinPly = 0;
+
+  counterMoves.fill(MOVE_NONE);
+  mainHistory.fill(0);
+  lowPlyHistory.fill(0);
+  captureHistory.fill(0);
+
+#if defined USE_MATE_3PLY
+  mate3Probes = mate3Hits = mate3Nodes = 0;
+#endif
+
+  // ここは、未初期化のときに[SQ_ZERO][NO_PIECE]を指すので、ここを-1で初期化しておくことによって、
+  // history > 0 を条件にすれば自ずと未初期化のときは除外されるようになる。
+  for (bool inCheck : { false, true })
+    for (StatsType c : { NoCaptures, Captures })
+    {
+      for (auto& to : continuationHistory[inCheck][c])
+        for (auto& h : to)
+          h->fill(0);
+      continuationHistory[inCheck][c][SQ_ZERO][NO_PIECE]->fill(Search::CounterMovePruneThreshold - 1);
+    }
+}
+
+
 /// Thread::wait_for_search_finished() waits on sleep condition
 /// until not searching
 
@@ -67,6 +109,53 @@ void Thread::idle_loop() {
 
   WinProcGroup::bindThisThread(idx);
 
+  if (isHelper) {
+    uint64_t epoch = Threads.searchEpoch;
+    {
+      // コンストラクタに起動したことを伝える。
+      std::lock_guard<Mutex> lk(mutex);
+      searching = false;
+      sleepCondition.notify_one();
+    }
+
+    while (true)
+    {
+      for (int i = 0; i < SpinCount && Threads.searchEpoch == epoch; ++i)
+        std::this_thread::yield();
+
+      {
+        std::unique_lock<Mutex> lk(Threads.wakeMutex);
+        Threads.wakeCondition.wait(lk, [&] {
+          std::lock_guard<Mutex> lk2(mutex);
+          return exit || Threads.searchEpoch != epoch;
+        });
+      }
+      {
+        std::lock_guard<Mutex> lk(mutex);
+        if (exit)
+          return;
+      }
+      epoch = Threads.searchEpoch;
+
+#if defined USE_SEARCH_STATS
+      searchStartTime = std::chrono::steady_clock::now();
+#endif
+      // 探索の準備は helper ごとに並列に行う。
+      rootPos = Position(Threads.setupPos, this);
+      rootMoves = Threads.setupRootMoves;
+      maxPly = 0;
+      rootDepth = Depth0;
+      rootEpoch = epoch;
+
+      search();
+
+      if (--Threads.helpersSearching == 0) {
+        std::lock_guard<Mutex> lk(Threads.wakeMutex);
+        Threads.finishCondition.notify_all();
+      }
+    }
+  }
+
   while (!exit)
   {
     std::unique_lock<Mutex> lk(mutex);
@@ -92,6 +181,9 @@ void ThreadPool::init() {
 }
 
 void ThreadPool::exit() {
+  delete mateThread;
+  mateThread = nullptr;
+
   while (size())
     delete back(), pop_back();
 }
@@ -108,15 +200,49 @@ void ThreadPool::readUSIOptions() {
       delete back(), pop_back();
 	}
 
+	// idx を通常のスレッドの後ろに揃える為、スレッド数が変わる度に作り直す。
+	delete mateThread;
+	mateThread = nullptr;
+	if (Options["Mate_Thread"])
+		mateThread = new MateThread();
+
 	// Init thread number dependent search params.
 	Search::init();
 }
 
+void ThreadPool::startHelpers(const Position& pos, const Search::RootMoves& rootMoves) {
+
+  if (size() == 1)
+    return;
+
+  // helper は探索中の main thread の rootPos を読めないので、ここに写しておく。
+  setupPos = pos;
+  setupRootMoves = rootMoves;
+  helpersSearching = int(size()) - 1;
+  {
+    std::lock_guard<Mutex> lk(wakeMutex);
+    ++searchEpoch;
+  }
+  wakeCondition.notify_all();
+}
+
+void ThreadPool::waitForHelpers() {
+
+  for (int i = 0; i < SpinCount && helpersSearching; ++i)
+    std::this_thread::yield();
+
+  std::unique_lock<Mutex> lk(wakeMutex);
+  finishCondition.wait(lk, [&] { return helpersSearching == 0; });
+}
+
 uint64_t ThreadPool::nodes_searched() {
 
+  // まだ今回の探索の準備をしていない helper は数えない。
+  const uint64_t epoch = searchEpoch;
   uint64_t nodes = 0;
   for (Thread* th : *this)
-      nodes += th->rootPos.nodesSearched();
+      if (th == front() || th->rootEpoch == epoch)
+          nodes += th->rootPos.nodesSearched();
   return nodes;
 }
 
@@ -130,6 +256,9 @@ void ThreadPool::startThinking(const Position& pos, const Search::LimitsType& li
 
   Search::Signals.stopOnPonderhit = Search::Signals.stop = false;
   Search::Limits = limits;
+#if defined USE_SEARCH_STATS
+  goTime = std::chrono::steady_clock::now();
+#endif
 
     main()->rootMoves.clear();
     main()->rootPos = pos;
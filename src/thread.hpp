@@ -14,15 +14,18 @@ class Thread {
   Mutex mutex;
   ConditionVariable sleepCondition;
   bool exit, searching;
+  // helper は start_searching() ではなく、ThreadPool::startHelpers() でまとめて起こす。
+  const bool isHelper;
 
 public:
-  Thread();
+  explicit Thread(bool helper = true);
   virtual ~Thread();
   virtual void search();
   void idle_loop();
   void start_searching(bool resume = false);
   void wait_for_search_finished();
   void wait(std::atomic_bool& b);
+  void clear();
 
     size_t pvIdx;
 	size_t idx;
@@ -47,13 +50,38 @@ public:
 
 	uint64_t ttHitAverage;
 
+	// helper が rootPos を作り直した探索の searchEpoch。
+	// ThreadPool::searchEpoch と違う間は rootPos に前回の node 数が残っていて、書き換え中でもあるので読まない。
+	std::atomic<uint64_t> rootEpoch{0};
+
+#if defined USE_SEARCH_STATS
+	// go を受けてからこのスレッドが探索を始めるまでの時間の計測用
+	std::chrono::steady_clock::time_point searchStartTime;
+#endif
+
+	// search(), qsearch() が子局面の為に使う StateInfo。ss->ply で引く。
+	// NNUE の Accumulator を含んで 1KB 以上あるので、C++ のスタックに置かずに連続した領域にまとめておく。
+	// 同じ ply の search() を入れ子に呼ぶ(null move の検証、singular extension など)のは doMove() していない間だけなので、
+	// ply ごとに 1 つあれば足りる。
+	alignas(64) StateInfo states[MaxPly + 10];
+
 	// nmpMinPly : null moveの前回の適用ply
 	// nmpColor  : null moveの前回の適用Color
 	int nmpMinPly;
 	Color nmpColor;
+
+#if defined USE_MATE_3PLY
+	// 3手詰め判定の呼び出し回数、詰みを見つけた回数、判定の中で進めた局面数。bench で表示する。
+	uint64_t mate3Probes, mate3Hits, mate3Nodes;
+#endif
+
+#if defined USE_SEARCH_STATS
+	Search::SearchStats stats;
+#endif
 };
 
 struct MainThread : public Thread {
+  MainThread() : Thread(false) {}
   virtual void search();
 
   bool easyMovePlayed, failedLow;
@@ -61,15 +89,51 @@ struct MainThread : public Thread {
   Score previousScore;
 };
 
+// 通常探索の裏で王手の連続による詰みだけを探すスレッド。
+// ThreadPool には含めず、見つけた詰みは置換表を通して他のスレッドに伝える。
+struct MateThread : public Thread {
+  MateThread() : Thread(false) {}
+  virtual void search();
+
+  // 詰まないことが分かった局面と、そのときの残り手数
+  struct DisproofEntry {
+    Key key;
+    int depth;
+  };
+  static const size_t DisproofTableSize = 1 << 16;
+  std::vector<DisproofEntry> disproofTable;
+  // 千日手で打ち切った回数。増えた局面の結果は手順に依存するので保存しない。
+  uint64_t repetitionCuts = 0;
+};
+
 struct ThreadPool : public std::vector<Thread*> {
 
 	void init();
 	void exit();
 
 	MainThread* main() { return static_cast<MainThread*>(at(0)); }
+	MateThread* mateThread = nullptr; // Mate_Thread が false なら nullptr
 	void startThinking(const Position& pos, const Search::LimitsType& limits, const std::vector<Move>& searchMoves);
     void readUSIOptions();
     uint64_t nodes_searched();
+
+	// main thread から helper を全て起こし、探索の終了を待つ。
+	// helper は setupPos, setupRootMoves から自分で探索の準備をする。
+	void startHelpers(const Position& pos, const Search::RootMoves& rootMoves);
+	void waitForHelpers();
+
+	// helper を起こす度に 1 つ増やす。helper は前回から変わっていれば探索を始める。
+	std::atomic<uint64_t> searchEpoch{0};
+	std::atomic<int> helpersSearching{0};
+	Mutex wakeMutex;
+	ConditionVariable wakeCondition;   // helper がこれで searchEpoch が変わるのを待つ
+	ConditionVariable finishCondition; // main thread がこれで helpersSearching が 0 になるのを待つ
+	Position setupPos;
+	Search::RootMoves setupRootMoves;
+
+#if defined USE_SEARCH_STATS
+	std::chrono::steady_clock::time_point goTime;
+#endif
 };
 
 extern ThreadPool Threads;
@@ -3,6 +3,7 @@
 #include "usi.hpp"
 #include "timeManager.hpp"
 #include <cfloat>
+#include <fstream>
 
 TimeManagement Time; // Our global time management object
 
@@ -74,6 +75,20 @@ void TimeManagement::init(Search::LimitsType& limits, Color us, int ply) {
       limits.npmsec = npmsec;
     }
 
+    logging = Options["TimeLog"];
+    iterations.clear();
+    if (logging) {
+      std::ostringstream ss;
+      ss << "{\"ply\":" << ply
+         << ",\"us\":\"" << (us == Black ? "b" : "w") << "\""
+         << ",\"time\":" << limits.time[us]
+         << ",\"inc\":" << limits.inc[us]
+         << ",\"byoyomi\":" << limits.moveTime
+         << ",\"movestogo\":" << limits.movesToGo
+         << ",\"ponder\":" << (limits.ponder ? "true" : "false");
+      logHeader = ss.str();
+    }
+
     startTime = limits.startTime;
 	optimumTime = maximumTime = std::max(limits.time[us], minThinkingTime);
 
@@ -116,3 +131,35 @@ void TimeManagement::init(Search::LimitsType& limits, Color us, int ply) {
 	SYNCCOUT << "info string optimum_search_time = " << optimumTime << SYNCENDL;
 	SYNCCOUT << "info string maximum_search_time = " << maximumTime << SYNCENDL;
 }
+
+void TimeManagement::logIteration(const int depth, const Score score, const Move move, const double bestMoveChanges, const bool failedLow) {
+	if (logging)
+		iterations.push_back({depth, elapsed(), score, move, bestMoveChanges, failedLow});
+}
+
+void TimeManagement::writeLog(const Move bestMove, const Score previousScore, const size_t rootMovesSize) {
+	if (!logging)
+		return;
+
+	std::ofstream ofs(static_cast<std::string>(Options["TimeLog_File"]), std::ios::app);
+	ofs << logHeader
+		<< ",\"optimum\":" << optimumTime
+		<< ",\"maximum\":" << maximumTime
+		<< ",\"elapsed\":" << elapsed()
+		<< ",\"root_moves\":" << rootMovesSize
+		<< ",\"previous_score\":" << previousScore
+		<< ",\"bestmove\":\"" << bestMove.toUSI() << "\""
+		<< ",\"iterations\":[";
+	for (size_t i = 0; i < iterations.size(); ++i) {
+		const IterationLog& it = iterations[i];
+		ofs << (i ? "," : "")
+			<< "{\"depth\":" << it.depth
+			<< ",\"elapsed\":" << it.elapsed
+			<< ",\"score\":" << it.score
+			<< ",\"move\":\"" << it.move.toUSI() << "\""
+			<< ",\"best_move_changes\":" << it.bestMoveChanges
+			<< ",\"failed_low\":" << (it.failedLow ? "true" : "false") << "}";
+	}
+	ofs << "]}" << std::endl;
+	iterations.clear();
+}
@@ -13,10 +13,27 @@ public:
   
   int64_t availableNodes; // When in 'nodes as time' mode
 
+  // TimeLog が true のとき、1 手ごとの持ち時間、optimum, maximum, 実際に使った時間と、反復深化の各深さの記録を
+  // TimeLog_File に 1 手 1 行の JSON で追記する。utils/timesim/time_simulator.rb で別の時間配分を試せる。
+  void logIteration(const int depth, const Score score, const Move move, const double bestMoveChanges, const bool failedLow);
+  void writeLog(const Move bestMove, const Score previousScore, const size_t rootMovesSize);
+
 private:
   TimePoint startTime;
   int optimumTime;
   int maximumTime;
+
+  struct IterationLog {
+    int depth;
+    int elapsed;
+    Score score;
+    Move move;
+    double bestMoveChanges;
+    bool failedLow;
+  };
+  bool logging;
+  std::string logHeader; // init() で作る、探索前に分かる部分
+  std::vector<IterationLog> iterations;
 };
 
 extern TimeManagement Time;
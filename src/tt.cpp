@@ -27,6 +27,9 @@ void TranspositionTable::resize(size_t mbSize) { // Mega Byte 指定
 
 void TranspositionTable::clear() {
   std::memset(table, 0, clusterCount * sizeof(Cluster));
+  // generation8 の bit 2 は TTEntry::is_pv() の bit と重なっていて探索結果に影響するので、
+  // 消した後は起動直後と同じ探索になるように戻しておく。
+  generation8 = 0;
 }
 
 TTEntry* TranspositionTable::probe(const Key key, bool& found) const {
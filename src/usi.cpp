@@ -96,13 +96,18 @@ void init(OptionsMap& o) {
 	o["Byoyomi_Margin"]              = Option(0, 0, INT_MAX);
     o["Inc_Margin"]                  = Option(3000, 0, INT_MAX);
 	o["MultiPV"]                     = Option(1, 1, MaxLegalMoves);
+	o["Parallel_MultiPV"]            = Option(false); // MultiPV の各 PV をスレッドで分担して探索する。
 	o["Skill_Level"]                 = Option(20, 0, 20);
 //	o["Max_Random_Score_Diff"]       = Option(0, 0, ScoreMate0Ply);
 //	o["Max_Random_Score_Diff_Ply"]   = Option(0, 0, SHRT_MAX);
 	o["Slow_Mover"]                  = Option(89, 10, 1000);
 	o["Minimum_Thinking_Time"]       = Option(10, 0, INT_MAX);
 	o["Threads"]                     = Option(cpuCoreCount(), 1, 512, onThreads);
+	o["Mate_Thread"]                 = Option(false, onThreads);
+	o["Mate_Thread_Ply"]             = Option(15, 1, 63);
     o["Move_Overhead"] = Option(30, 0, 5000);
+	o["TimeLog"]       = Option(false);
+	o["TimeLog_File"]  = Option("timelog.jsonl");
     o["nodestime"]     = Option(0, 0, 10000);
 	o["PvInterval"]    = Option(100, 0, 10000);
 	o["Contempt"]      = Option(0, -100, 100);
@@ -324,6 +329,18 @@ Move csaToMove(const Position& pos, const std::string& moveStr) {
 	return move;
 }
 
+namespace {
+	// 前回の position コマンドで作った局面。
+	// 対局中は前回の指し手に 1, 2 手足したものが送られてくるので、増えた指し手だけ指せば良い。
+	struct LastPosition {
+		bool valid = false;
+		std::string sfen;
+		std::string moves;              // 実際に指せた指し手の部分の文字列
+		Key key;                        // pos が他で変えられていないか確かめる為の、最後の局面の key
+		Ply ply;
+	} lastPosition;
+}
+
 void setPosition(Position& pos, std::istringstream& ssCmd) {
 	std::string token;
 	std::string sfen;
@@ -341,18 +358,49 @@ void setPosition(Position& pos, std::istringstream& ssCmd) {
 	else
 		return;
 
-	pos.set(sfen, Threads.main());
-	Search::SetUpStates = StateStackPtr(new std::stack<StateInfo>());
+	// 指し手の部分は文字列のまま前回と比べ、増えた部分だけを読む。
+	std::string moves;
+	std::getline(ssCmd, moves);
+	const size_t lastSize = lastPosition.moves.size();
+
+	// 前回と同じ開始局面で、前回の指し手の続きなら、SetUpStates (NNUE の accumulator を含む) をそのまま使い、
+	// 増えた指し手だけ指す。pos が前回の局面のままか、key と手数でも確かめる。
+	size_t begin = 0;
+	if (lastPosition.valid
+		&& Search::SetUpStates
+		&& lastPosition.sfen == sfen
+		&& moves.compare(0, lastSize, lastPosition.moves) == 0
+		&& (moves.size() == lastSize || lastSize == 0 || moves[lastSize] == ' ' || moves[lastSize - 1] == ' ')
+		&& pos.getKey() == lastPosition.key
+		&& pos.gamePly() == lastPosition.ply)
+	{
+		begin = lastSize;
+	}
+	else {
+		pos.set(sfen, Threads.main());
+		Search::SetUpStates = StateStackPtr(new std::stack<StateInfo>());
+	}
 
+	std::istringstream ssMoves(moves.substr(begin));
+	// 実際に指せた指し手の部分の、moves での終わりの位置
+	size_t end = begin;
 	Ply currentPly = pos.gamePly();
-	while (ssCmd >> token) {
+	while (ssMoves >> token) {
 		const Move move = usiToMove(pos, token);
 		if (!move) break;
 		Search::SetUpStates->push(StateInfo());
 		pos.doMove(move, Search::SetUpStates->top());
 		++currentPly;
+		end = (ssMoves.eof() ? moves.size() : begin + static_cast<size_t>(ssMoves.tellg()));
 	}
 	pos.setStartPosPly(currentPly);
+
+	moves.resize(end);
+	lastPosition.valid = true;
+	lastPosition.sfen = sfen;
+	lastPosition.moves = std::move(moves);
+	lastPosition.key = pos.getKey();
+	lastPosition.ply = pos.gamePly();
 }
 
 void setOption(std::istringstream& ssCmd) {
@@ -419,6 +467,322 @@ void measureGenerateMoves(const Position& pos) {
 		std::cout << legalMoves[i].move.toCSA() << ", ";
 	std::cout << std::endl;
 }
+
+// for debug
+// perft
+// 指定した深さまでの合法手の数を数える。最後の 1 手は指し手を生成した数をそのまま足す。(bulk counting)
+// 既知の値と比べる為に、歩、角、飛の不成も含めた LegalAll で数える。
+namespace {
+	// 同じ局面を同じ深さで数えた結果を使い回す為の表。
+	// 複数スレッドから lock せずに読み書きするので、key を data と xor して書き、壊れたエントリは使わない。
+	struct PerftHashEntry {
+		u64 keyXorData;
+		u64 data; // nodes << 8 | depth
+	};
+	std::vector<PerftHashEntry> PerftHash;
+
+	u64 perft(Position& pos, const int depth) {
+		MoveList<LegalAll> ml(pos);
+		if (depth == 1)
+			return ml.size();
+
+		PerftHashEntry* e = nullptr;
+		const Key key = pos.getKey();
+		if (!PerftHash.empty()) {
+			e = &PerftHash[key & (PerftHash.size() - 1)];
+			const u64 data = e->data;
+			if ((e->keyXorData ^ data) == key && int(data & 0xff) == depth)
+				return data >> 8;
+		}
+
+		u64 nodes = 0;
+		StateInfo st;
+		for (; !ml.end(); ++ml) {
+			pos.doMove(ml.move(), st);
+			nodes += perft(pos, depth - 1);
+			pos.undoMove(ml.move());
+		}
+
+		if (e) {
+			const u64 data = (nodes << 8) | depth;
+			e->keyXorData = key ^ data;
+			e->data = data;
+		}
+		return nodes;
+	}
+
+	// 局面の数を返す。root の指し手を threads 個のスレッドで分担する。divide なら root の指し手ごとの数も表示する。
+	u64 perftRoot(const Position& pos, const int depth, const int threads, const bool divide) {
+		std::vector<Move> moves;
+		for (MoveList<LegalAll> ml(pos); !ml.end(); ++ml)
+			moves.push_back(ml.move());
+		std::vector<u64> counts(moves.size(), 1);
+
+		if (1 < depth) {
+			std::atomic<size_t> next(0);
+			auto worker = [&] {
+				Position p(pos);
+				StateInfo st;
+				for (size_t i; (i = next++) < moves.size(); ) {
+					p.doMove(moves[i], st);
+					counts[i] = perft(p, depth - 1);
+					p.undoMove(moves[i]);
+				}
+			};
+			std::vector<std::thread> workers;
+			for (int i = 1; i < threads; ++i)
+				workers.emplace_back(worker);
+			worker();
+			for (std::thread& t : workers)
+				t.join();
+		}
+
+		u64 nodes = 0;
+		for (size_t i = 0; i < moves.size(); ++i) {
+			if (divide)
+				std::cout << moves[i].toUSI() << ": " << counts[i] << std::endl;
+			nodes += counts[i];
+		}
+		return nodes;
+	}
+
+	void printPerftResult(const u64 nodes, const int elapsed) {
+		std::cout << "nodes = " << nodes
+				  << ", time = " << elapsed << " [msec]"
+				  << ", nps = " << nodes * 1000 / std::max(elapsed, 1) << std::endl;
+	}
+
+	// 局面数が分かっている局面で、指し手生成と doMove(), undoMove() を検証する。
+	void perftTest(const int threads) {
+		const struct {
+			const char* sfen;
+			int depth;
+			u64 nodes;
+		} Positions[] = {
+			{"lnsgkgsnl/1r5b1/ppppppppp/9/9/9/PPPPPPPPP/1B5R1/LNSGKGSNL b - 1", 1, 30},
+			{"lnsgkgsnl/1r5b1/ppppppppp/9/9/9/PPPPPPPPP/1B5R1/LNSGKGSNL b - 1", 2, 900},
+			{"lnsgkgsnl/1r5b1/ppppppppp/9/9/9/PPPPPPPPP/1B5R1/LNSGKGSNL b - 1", 3, 25470},
+			{"lnsgkgsnl/1r5b1/ppppppppp/9/9/9/PPPPPPPPP/1B5R1/LNSGKGSNL b - 1", 4, 719731},
+			{"lnsgkgsnl/1r5b1/ppppppppp/9/9/9/PPPPPPPPP/1B5R1/LNSGKGSNL b - 1", 5, 19861490},
+			// 指し手の多い中盤の局面
+			{"l6nl/5+P1gk/2np1S3/p1p4Pp/3P2Sp1/1PPb2P1P/P5GS1/R8/LN4bKL w RGgsn5p 1", 1, 207},
+			{"l6nl/5+P1gk/2np1S3/p1p4Pp/3P2Sp1/1PPb2P1P/P5GS1/R8/LN4bKL w RGgsn5p 1", 2, 28684},
+			{"l6nl/5+P1gk/2np1S3/p1p4Pp/3P2Sp1/1PPb2P1P/P5GS1/R8/LN4bKL w RGgsn5p 1", 3, 4809015},
+			// 合法手が最大の局面
+			{"R8/2K1S1SSk/4B4/9/9/9/9/9/1L1L1L3 b RBGSNLP3g3n17p 1", 1, 593},
+		};
+
+		bool allOk = true;
+		for (auto& p : Positions) {
+			const Position pos(p.sfen, Threads.main());
+			const Timer t = Timer::currentTime();
+			const u64 nodes = perftRoot(pos, p.depth, threads, false);
+			const bool ok = (nodes == p.nodes);
+			allOk &= ok;
+			std::cout << (ok ? "ok " : "NG ") << p.sfen << " depth " << p.depth
+					  << " expected " << p.nodes << ", ";
+			printPerftResult(nodes, t.elapsed());
+		}
+		std::cout << (allOk ? "perft test passed" : "perft test FAILED") << std::endl;
+	}
+}
+
+// perft <depth> [threads <n>] [hash <MB>]
+// divide <depth> [threads <n>] [hash <MB>]
+// perft test [threads <n>]
+void perftCommand(const Position& pos, std::istringstream& ssCmd, const bool divide) {
+	std::string token;
+	int depth = 0;
+	int threads = 1;
+	size_t hashMB = 0;
+	bool test = false;
+	while (ssCmd >> token) {
+		if      (token == "threads") ssCmd >> threads;
+		else if (token == "hash"   ) ssCmd >> hashMB;
+		else if (token == "test"   ) test = true;
+		else                         depth = atoi(token.c_str());
+	}
+	threads = std::max(threads, 1);
+
+	PerftHash.clear();
+	if (hashMB) {
+		size_t size = 1;
+		while (size * 2 * sizeof(PerftHashEntry) <= hashMB * 1024 * 1024)
+			size *= 2;
+		PerftHash.assign(size, PerftHashEntry{0, 0});
+	}
+
+	if (test)
+		perftTest(threads);
+	else if (0 < depth) {
+		const Timer t = Timer::currentTime();
+		const u64 nodes = perftRoot(pos, depth, threads, divide);
+		printPerftResult(nodes, t.elapsed());
+	}
+	else
+		std::cout << "usage: perft <depth> [threads <n>] [hash <MB>], perft test [threads <n>]" << std::endl;
+
+	PerftHash.clear();
+	PerftHash.shrink_to_fit();
+}
+
+// for debug
+// 王手生成の検証と速度計測
+// Check を合法手に絞ったものと LegalAll を王手に絞ったもの、
+// QuietCheck と NonCaptureMinusPro + Drop を王手に絞ったものがそれぞれ一致するかを調べる。
+void measureGenerateCheckMoves(const Position& pos) {
+	pos.print();
+	if (pos.inCheck()) {
+		std::cout << "in check" << std::endl;
+		return;
+	}
+
+	const CheckInfo ci(pos);
+	auto compare = [](const char* name, std::vector<Move>& expected, std::vector<Move>& generated) {
+		std::sort(std::begin(expected), std::end(expected));
+		std::sort(std::begin(generated), std::end(generated));
+		std::cout << name << " : " << (expected == generated ? "ok" : "NG") << ", num of moves = " << generated.size() << std::endl;
+		for (const Move m : generated)
+			std::cout << m.toCSA() << ", ";
+		std::cout << std::endl;
+	};
+
+	std::vector<Move> expected, generated;
+	for (MoveList<LegalAll> ml(pos); !ml.end(); ++ml)
+		if (pos.moveGivesCheck(ml.move(), ci))
+			expected.push_back(ml.move());
+	for (MoveList<Check> ml(pos); !ml.end(); ++ml)
+		if (pos.pseudoLegalMoveIsLegal<false, false>(ml.move(), ci.pinned))
+			generated.push_back(ml.move());
+	compare("Check", expected, generated);
+
+	expected.clear();
+	generated.clear();
+	ExtMove moves[MaxLegalMoves];
+	ExtMove* last = generateMoves<Drop>(generateMoves<NonCaptureMinusPro>(moves, pos), pos);
+	for (ExtMove* it = moves; it != last; ++it)
+		if (pos.moveGivesCheck(it->move, ci))
+			expected.push_back(it->move);
+	for (MoveList<QuietCheck> ml(pos); !ml.end(); ++ml)
+		generated.push_back(ml.move());
+	compare("QuietCheck", expected, generated);
+
+	const u64 num = 1000000;
+	u64 count = 0;
+	Timer t = Timer::currentTime();
+	for (u64 i = 0; i < num; ++i)
+		count += generateMoves<Check>(moves, pos) - moves;
+	const int elapsedCheck = t.elapsed();
+
+	t = Timer::currentTime();
+	for (u64 i = 0; i < num; ++i) {
+		last = generateMoves<NonEvasion>(moves, pos);
+		for (ExtMove* it = moves; it != last; ++it)
+			count += pos.moveGivesCheck(it->move, ci);
+	}
+	const int elapsedFilter = t.elapsed();
+
+	std::cout << "Check                     : " << elapsedCheck  << " [msec]" << std::endl;
+	std::cout << "NonEvasion + moveGivesCheck : " << elapsedFilter << " [msec]" << std::endl;
+	std::cout << "(" << count << ")" << std::endl;
+}
+
+// for debug
+// PackedPosition に詰めて戻した局面が元と同じか確かめ、SFEN 文字列からの set() と速度を比べる。
+void measurePackedPosition(const Position& pos) {
+	PackedPosition pp;
+	if (!pos.pack(pp)) {
+		std::cout << "cannot pack (not all 40 pieces are on the board or in hand)" << std::endl;
+		return;
+	}
+	std::cout << "packed = " << std::hex << std::setfill('0');
+	for (const u8 b : pp.data)
+		std::cout << std::setw(2) << static_cast<int>(b);
+	std::cout << std::dec << std::setfill(' ') << std::endl;
+
+	// 手数は PackedPosition に含まないので比べない。
+	auto withoutPly = [](const std::string& sfen) { return sfen.substr(0, sfen.find_last_of(' ')); };
+	const std::string sfen = pos.toSFEN();
+	Position p;
+	const bool unpacked = p.setFromPacked(pp, pos.thisThread());
+	std::cout << "sfen = " << sfen << std::endl;
+	std::cout << "unpacked : " << (unpacked && p.getKey() == pos.getKey() && withoutPly(p.toSFEN()) == withoutPly(sfen) ? "ok" : "NG") << std::endl;
+
+	const u64 num = 200000;
+	u64 count = 0;
+	Timer t = Timer::currentTime();
+	for (u64 i = 0; i < num; ++i) {
+		p.set(sfen, pos.thisThread());
+		count += p.getKey();
+	}
+	const int elapsedSet = t.elapsed();
+
+	t = Timer::currentTime();
+	for (u64 i = 0; i < num; ++i) {
+		p.setFromPacked(pp, pos.thisThread());
+		count += p.getKey();
+	}
+	const int elapsedUnpack = t.elapsed();
+
+	t = Timer::currentTime();
+	for (u64 i = 0; i < num; ++i) {
+		pos.pack(pp);
+		count += pp.data[i & 31];
+	}
+	const int elapsedPack = t.elapsed();
+
+	std::cout << "set(sfen)     x " << num << " : " << elapsedSet    << " [msec]" << std::endl;
+	std::cout << "setFromPacked x " << num << " : " << elapsedUnpack << " [msec]" << std::endl;
+	std::cout << "pack          x " << num << " : " << elapsedPack   << " [msec]" << std::endl;
+	std::cout << "(" << count << ")" << std::endl;
+}
+
+// for debug
+// 利き数 (USE_ATTACK_COUNTS) の損得を調べる為に、差分更新が入る doMove() と、
+// 利き数で速くなる判定のそれぞれの速度を計測する。有効、無効で build して比べること。
+void measureAttackCounts(Position& pos) {
+	pos.print();
+#if defined USE_ATTACK_COUNTS
+	std::cout << "USE_ATTACK_COUNTS : on" << std::endl;
+#else
+	std::cout << "USE_ATTACK_COUNTS : off" << std::endl;
+#endif
+
+	u64 count = 0;
+	StateInfo st;
+	const u64 numDoMove = 200000;
+	Timer t = Timer::currentTime();
+	for (u64 i = 0; i < numDoMove; ++i) {
+		for (MoveList<Legal> ml(pos); !ml.end(); ++ml) {
+			pos.doMove(ml.move(), st);
+			pos.undoMove(ml.move());
+			++count;
+		}
+	}
+	const int elapsedDoMove = t.elapsed();
+
+	const u64 numIsAny = 2000000;
+	t = Timer::currentTime();
+	for (u64 i = 0; i < numIsAny; ++i) {
+		for (Square sq = SQ11; sq < SquareNum; ++sq)
+			count += pos.attackersToIsAny(Black, sq) + pos.attackersToIsAny(White, sq);
+	}
+	const int elapsedIsAny = t.elapsed();
+
+	const u64 numMate1 = 2000000;
+	int elapsedMate1 = 0;
+	if (!pos.inCheck()) {
+		t = Timer::currentTime();
+		for (u64 i = 0; i < numMate1; ++i)
+			count += pos.mateMoveIn1Ply().value();
+		elapsedMate1 = t.elapsed();
+	}
+
+	std::cout << "doMove + undoMove (all legal moves) x " << numDoMove << " : " << elapsedDoMove << " [msec]" << std::endl;
+	std::cout << "attackersToIsAny (all squares)      x " << numIsAny  << " : " << elapsedIsAny  << " [msec]" << std::endl;
+	std::cout << "mateMoveIn1Ply                      x " << numMate1  << " : " << elapsedMate1  << " [msec]" << std::endl;
+	std::cout << "(" << count << ")" << std::endl;
+}
 #endif
 
 #ifdef NDEBUG
@@ -484,14 +848,16 @@ void USI::loop(int argc, char* argv[]) {
 		ssCmd >> std::skipws >> token;
 
 		if (token == "quit" || token == "stop" || token == "ponderhit" || token == "gameover") {
+			if (token == "ponderhit" && Search::Limits.moveTime != 0)
+              Search::Limits.moveTime += Time.elapsed();
 			if (token != "ponderhit" || Search::Signals.stopOnPonderhit) {
               Search::Signals.stop = true;
 				Threads.main()->start_searching(true);
 			}
-			else
+			else {
 				Search::Limits.ponder = false;
-			if (token == "ponderhit" && Search::Limits.moveTime != 0)
-              Search::Limits.moveTime += Time.elapsed();
+				Search::ponderhit();
+			}
 		}
 		else if (token == "usinewgame") {
             Search::clear();
@@ -509,6 +875,8 @@ void USI::loop(int argc, char* argv[]) {
 			// NNUE評価関数ファイルの読込み
 			Eval::load_eval(Options["Eval_Dir"]);
 #endif
+			// 評価関数を読み直すと SetUpStates の差分計算の結果が使えなくなるので、次の position では局面を作り直す。
+			lastPosition.valid = false;
 			SYNCCOUT << "readyok" << SYNCENDL;
 		}
 		else if (token == "position" ) setPosition(pos, ssCmd);
@@ -532,8 +900,15 @@ void USI::loop(int argc, char* argv[]) {
 		else if (token == "key"      ) SYNCCOUT << pos.getKey() << SYNCENDL;
 		else if (token == "d"        ) pos.print();
 		else if (token == "s"        ) measureGenerateMoves(pos);
+		else if (token == "c"        ) measureGenerateCheckMoves(pos);
+		else if (token == "k"        ) measureAttackCounts(pos);
+		else if (token == "pack"     ) measurePackedPosition(pos);
+		else if (token == "perft"    ) perftCommand(pos, ssCmd, false);
+		else if (token == "divide"   ) perftCommand(pos, ssCmd, true);
 		else if (token == "t"        ) std::cout << pos.mateMoveIn1Ply().toCSA() << std::endl;
+		else if (token == "t3"       ) std::cout << pos.mateMoveIn3Ply().toCSA() << std::endl;
 		else if (token == "b"        ) makeBook(pos, ssCmd);
+		else if (token == "bx"       ) makeBookExternal(ssCmd);
 #endif
 
 #if defined(EVAL_NNUE)
@@ -33,6 +33,12 @@ if [ $? != 0 ]; then
   exit 1
 fi
 
+./perft.sh
+if [ $? != 0 ]; then
+  echo "testing failed(perft.sh)"
+  exit 1
+fi
+
 ./benchmark.sh
 if [ $? != 0 ]; then
   echo "testing failed(benchmark.sh)"
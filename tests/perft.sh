@@ -0,0 +1,26 @@
+#!/bin/bash
+
+error()
+{
+  echo "perft testing failed on line $1"
+  exit 1
+}
+trap 'error ${LINENO}' ERR
+
+echo "perft testing started"
+
+(
+  echo "perft test threads 2";
+  echo "quit";
+) | ./apery-by-clang | tee result.txt
+
+# 局面数が分かっている局面で、全て一致しない場合は失敗
+rtn=`grep "perft test passed" result.txt | wc -l`
+if [ "x${rtn}" != "x1" ]; then
+  echo "perft testing failed(nodes?)"
+  exit 1
+fi
+
+rm result.txt
+echo "---"
+echo "perft testing OK"
@@ -0,0 +1,308 @@
+// 定跡ファイル (BookEntry を key の昇順に並べたもの) を、いくつでも同時に順に読んで merge する。
+// 同じ局面の指し手だけをメモリに置くので、大きな定跡でも使うメモリは一定。
+//
+// book_tool [options] <book.bin>...
+//   -o <file>           出力する定跡ファイル (既定値 book.bin)
+//   --score <policy>    同じ指し手が複数の定跡にあるときの点数の決め方
+//                       first (既定値): コマンドラインで先の定跡, last, max, min, mean
+//   --score-from <file> 点数だけを取る定跡。この定跡にしか無い指し手は追加しない。(複数指定可)
+//   --min-count <n>     出現回数の合計が n 未満の指し手を削除する。
+//   --min-score <s>     点数が s 未満の指し手を削除する。
+//   --max-score <s>     点数が s より大きい指し手を削除する。
+//   --erase <file>      "<key> <fromToPro>" の行の指し手を削除する。fromToPro を省くと局面ごと削除する。
+//                       # 以降はコメント。(複数指定可)
+//
+// 出現回数は足し合わせ、局面毎に出現回数の降順に並べて書き出す。
+// 出力は <file>.tmp に書き、最後まで書けたら <file> に置き換えるので、途中で失敗しても元の <file> は残る。
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <memory>
+#include <queue>
+#include <limits>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstdio>
+
+struct BookEntry {
+	uint64_t key;
+	uint16_t fromToPro;
+	uint16_t count;
+	int32_t score;
+};
+
+// 定跡ファイルを少しずつ読む。
+class BookReader {
+public:
+	BookReader(const std::string& fileName, const bool scoreOnly)
+		: fileName_(fileName), ifs_(fileName.c_str(), std::ios::binary), buf_(1 << 16), scoreOnly_(scoreOnly)
+	{
+		if (ifs_) {
+			ifs_.seekg(0, std::ios::end);
+			fileSize_ = static_cast<uint64_t>(ifs_.tellg());
+			ifs_.seekg(0, std::ios::beg);
+		}
+		fill();
+	}
+	bool good() const { return static_cast<bool>(ifs_) || size_ != 0; }
+	// 途中で切れた BookEntry が無い。
+	bool wholeEntries() const { return fileSize_ % sizeof(BookEntry) == 0; }
+	bool empty() const { return pos_ == size_; }
+	const BookEntry& front() const { return buf_[pos_]; }
+	bool scoreOnly() const { return scoreOnly_; }
+	const std::string& fileName() const { return fileName_; }
+	// key の順に並んでいなければ false
+	bool pop() {
+		const uint64_t prev = front().key;
+		if (++pos_ == size_)
+			fill();
+		return empty() || prev <= front().key;
+	}
+
+private:
+	void fill() {
+		ifs_.read(reinterpret_cast<char*>(buf_.data()), buf_.size() * sizeof(BookEntry));
+		size_ = ifs_.gcount() / sizeof(BookEntry);
+		pos_ = 0;
+	}
+
+	std::string fileName_;
+	std::ifstream ifs_;
+	std::vector<BookEntry> buf_;
+	uint64_t fileSize_ = 0;
+	size_t size_ = 0;
+	size_t pos_ = 0;
+	bool scoreOnly_;
+};
+
+enum ScorePolicy { ScoreFirst, ScoreLast, ScoreMax, ScoreMin, ScoreMean };
+
+struct Options {
+	std::string output = "book.bin";
+	ScorePolicy scorePolicy = ScoreFirst;
+	uint32_t minCount = 0;
+	int32_t minScore = std::numeric_limits<int32_t>::min();
+	int32_t maxScore = std::numeric_limits<int32_t>::max();
+	std::set<std::pair<uint64_t, uint16_t> > eraseMoves;
+	std::set<uint64_t> eraseKeys;
+};
+
+// 同じ key, fromToPro を持つ指し手をまとめたもの。
+struct MergedMove {
+	uint16_t fromToPro;
+	uint32_t count;
+	int64_t scoreSum;
+	int32_t score;
+	int scoreNum;
+	bool hasEntry;    // score-from 以外の定跡にある。
+	bool hasOverride; // score-from の定跡にある。
+	int32_t overrideScore;
+};
+
+void usage() {
+	std::cout << "USAGE: book_tool [-o <output>] [--score first|last|max|min|mean] [--score-from <book>]...\n"
+			  << "                 [--min-count <n>] [--min-score <s>] [--max-score <s>] [--erase <list>]...\n"
+			  << "                 <book>..." << std::endl;
+}
+
+bool readEraseList(const std::string& fileName, Options& opt) {
+	std::ifstream ifs(fileName.c_str());
+	if (!ifs) {
+		std::cout << "I cannot open " << fileName << std::endl;
+		return false;
+	}
+	std::string line;
+	while (std::getline(ifs, line)) {
+		line = line.substr(0, line.find('#'));
+		std::istringstream ss(line);
+		uint64_t key;
+		if (!(ss >> key))
+			continue;
+		uint16_t fromToPro;
+		if (ss >> fromToPro)
+			opt.eraseMoves.emplace(key, fromToPro);
+		else
+			opt.eraseKeys.insert(key);
+	}
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	Options opt;
+	std::vector<std::unique_ptr<BookReader> > books;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool hasValue = (i + 1 < argc);
+		if (arg == "-o" && hasValue)
+			opt.output = argv[++i];
+		else if (arg == "--score" && hasValue) {
+			const std::string policy = argv[++i];
+			if      (policy == "first") opt.scorePolicy = ScoreFirst;
+			else if (policy == "last" ) opt.scorePolicy = ScoreLast;
+			else if (policy == "max"  ) opt.scorePolicy = ScoreMax;
+			else if (policy == "min"  ) opt.scorePolicy = ScoreMin;
+			else if (policy == "mean" ) opt.scorePolicy = ScoreMean;
+			else {
+				usage();
+				return 1;
+			}
+		}
+		else if (arg == "--score-from" && hasValue)
+			books.emplace_back(new BookReader(argv[++i], true));
+		else if (arg == "--min-count" && hasValue)
+			opt.minCount = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--min-score" && hasValue)
+			opt.minScore = std::strtol(argv[++i], nullptr, 10);
+		else if (arg == "--max-score" && hasValue)
+			opt.maxScore = std::strtol(argv[++i], nullptr, 10);
+		else if (arg == "--erase" && hasValue) {
+			if (!readEraseList(argv[++i], opt))
+				return 1;
+		}
+		else if (!arg.empty() && arg[0] == '-') {
+			usage();
+			return 1;
+		}
+		else
+			books.emplace_back(new BookReader(arg, false));
+	}
+	if (std::none_of(books.begin(), books.end(), [](const std::unique_ptr<BookReader>& b) { return !b->scoreOnly(); })) {
+		usage();
+		return 1;
+	}
+	for (const auto& book : books) {
+		if (!book->good()) {
+			std::cout << "I cannot open " << book->fileName() << std::endl;
+			return 1;
+		}
+		if (!book->wholeEntries()) {
+			std::cout << book->fileName() << " size is not a multiple of " << sizeof(BookEntry) << " bytes" << std::endl;
+			return 1;
+		}
+	}
+
+	// key の小さい定跡から取り出す。同じ key なら、コマンドラインで先の定跡から。
+	const auto greater = [&](const size_t lhs, const size_t rhs) {
+		const uint64_t lkey = books[lhs]->front().key;
+		const uint64_t rkey = books[rhs]->front().key;
+		return lkey != rkey ? rkey < lkey : rhs < lhs;
+	};
+	std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> queue(greater);
+	for (size_t i = 0; i < books.size(); ++i) {
+		if (!books[i]->empty())
+			queue.push(i);
+	}
+
+	const std::string tmpOutput = opt.output + ".tmp";
+	std::ofstream ofs(tmpOutput.c_str(), std::ios::binary);
+	if (!ofs) {
+		std::cout << "I cannot open " << tmpOutput << std::endl;
+		return 1;
+	}
+	std::vector<BookEntry> outBuf;
+	uint64_t inNum = 0;
+	uint64_t outNum = 0;
+	std::vector<MergedMove> moves;
+
+	const auto flush = [&](const uint64_t key) {
+		std::vector<BookEntry> entries;
+		for (const MergedMove& m : moves) {
+			if (!m.hasEntry || opt.eraseMoves.count(std::make_pair(key, m.fromToPro)))
+				continue;
+			int32_t score = m.score;
+			if (m.hasOverride)
+				score = m.overrideScore;
+			else if (opt.scorePolicy == ScoreMean)
+				score = static_cast<int32_t>(m.scoreSum / m.scoreNum);
+			if (m.count < opt.minCount || score < opt.minScore || opt.maxScore < score)
+				continue;
+			BookEntry be;
+			be.key = key;
+			be.fromToPro = m.fromToPro;
+			be.count = static_cast<uint16_t>(std::min<uint32_t>(m.count, std::numeric_limits<uint16_t>::max()));
+			be.score = score;
+			entries.push_back(be);
+		}
+		std::stable_sort(entries.begin(), entries.end(), [](const BookEntry& lhs, const BookEntry& rhs) { return lhs.count > rhs.count; });
+		outBuf.insert(outBuf.end(), entries.begin(), entries.end());
+		outNum += entries.size();
+		if (outBuf.size() >= (1 << 16)) {
+			ofs.write(reinterpret_cast<const char*>(outBuf.data()), outBuf.size() * sizeof(BookEntry));
+			outBuf.clear();
+		}
+		moves.clear();
+	};
+
+	uint64_t currentKey = 0;
+	while (!queue.empty()) {
+		const size_t i = queue.top();
+		queue.pop();
+		BookReader& book = *books[i];
+		const BookEntry be = book.front();
+		if (!book.pop()) {
+			std::cout << book.fileName() << " is not sorted by key" << std::endl;
+			ofs.close();
+			std::remove(tmpOutput.c_str());
+			return 1;
+		}
+		if (!book.empty())
+			queue.push(i);
+		++inNum;
+
+		if (!moves.empty() && be.key != currentKey)
+			flush(currentKey);
+		currentKey = be.key;
+		if (opt.eraseKeys.count(be.key))
+			continue;
+
+		auto it = std::find_if(moves.begin(), moves.end(), [&](const MergedMove& m) { return m.fromToPro == be.fromToPro; });
+		if (it == moves.end()) {
+			MergedMove m = {};
+			m.fromToPro = be.fromToPro;
+			moves.push_back(m);
+			it = moves.end() - 1;
+		}
+		if (book.scoreOnly()) {
+			if (!it->hasOverride) {
+				it->hasOverride = true;
+				it->overrideScore = be.score;
+			}
+			continue;
+		}
+		it->count += be.count;
+		it->scoreSum += be.score;
+		if (it->scoreNum == 0
+			|| opt.scorePolicy == ScoreLast
+			|| (opt.scorePolicy == ScoreMax && it->score < be.score)
+			|| (opt.scorePolicy == ScoreMin && be.score < it->score))
+		{
+			it->score = be.score;
+		}
+		++it->scoreNum;
+		it->hasEntry = true;
+	}
+	if (!moves.empty())
+		flush(currentKey);
+	ofs.write(reinterpret_cast<const char*>(outBuf.data()), outBuf.size() * sizeof(BookEntry));
+	ofs.close();
+	if (!ofs) {
+		std::cout << "I cannot write " << tmpOutput << std::endl;
+		std::remove(tmpOutput.c_str());
+		return 1;
+	}
+	// Windows の rename() は既存のファイルを上書きしないので、失敗したら消してからもう一度試す。
+	if (std::rename(tmpOutput.c_str(), opt.output.c_str()) != 0
+		&& (std::remove(opt.output.c_str()) != 0 || std::rename(tmpOutput.c_str(), opt.output.c_str()) != 0))
+	{
+		std::cout << "I cannot rename " << tmpOutput << " to " << opt.output << std::endl;
+		return 1;
+	}
+
+	std::cout << "read " << inNum << " entries, wrote " << outNum << " entries to " << opt.output << std::endl;
+}
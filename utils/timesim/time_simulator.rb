@@ -0,0 +1,98 @@
+#!/usr/bin/env ruby
+# -*- coding: utf-8 -*-
+
+# TimeLog_File (setoption name TimeLog value true) の記録を読み、
+# 別の時間配分で探索を打ち切っていたら何秒使い、どの指し手を指していたかを調べる。
+#
+# 記録には実際に探索した深さまでしか無いので、実際より長く考える配分では最後の深さの結果を使う。(truncated に数える)
+# EasyMove による打ち切りは再現しない。
+
+require 'json'
+
+if ARGV.empty?
+  puts "USAGE: " + __FILE__ + " <timelog.jsonl>..."
+  puts "This program replays time logs under alternative time allocation policies."
+  exit
+end
+
+# optimum_scale : optimum を何倍にするか
+# maximum_scale : maximum を何倍にするか (ただし元の maximum を超えない)
+# unstable      : 最善手の変化の回数で時間を延ばすか
+# improving     : 評価値の変化で時間を延ばすか
+Policies = [
+            { name: "current",     optimum_scale: 1.0, maximum_scale: 1.0, unstable: true,  improving: true  },
+            { name: "optimum x0.5",optimum_scale: 0.5, maximum_scale: 1.0, unstable: true,  improving: true  },
+            { name: "optimum x0.7",optimum_scale: 0.7, maximum_scale: 1.0, unstable: true,  improving: true  },
+            { name: "optimum x1.5",optimum_scale: 1.5, maximum_scale: 1.0, unstable: true,  improving: true  },
+            { name: "optimum x2.0",optimum_scale: 2.0, maximum_scale: 1.0, unstable: true,  improving: true  },
+            { name: "maximum x0.5",optimum_scale: 1.0, maximum_scale: 0.5, unstable: true,  improving: true  },
+            { name: "no unstable", optimum_scale: 1.0, maximum_scale: 1.0, unstable: false, improving: true  },
+            { name: "no improving",optimum_scale: 1.0, maximum_scale: 1.0, unstable: true,  improving: false },
+            { name: "fixed",       optimum_scale: 1.0, maximum_scale: 1.0, unstable: false, improving: false },
+           ]
+
+# search.cpp の Thread::search() の打ち切り条件と同じ計算
+def improving_factor record, iteration
+  f0 = iteration["failed_low"] ? 1 : 0
+  f1 = iteration["score"] - record["previous_score"]
+  [229, [715, 357 + 119 * f0 - 6 * f1].min].max
+end
+
+# 1 手分を policy で探索したときの [使った時間, 指し手, 深さ, truncated]
+def simulate record, policy
+  iterations = record["iterations"]
+  optimum = record["optimum"] * policy[:optimum_scale]
+  maximum = [record["maximum"] * policy[:maximum_scale], record["maximum"]].min
+
+  prev = nil
+  iterations.each do |it|
+    # この深さを終える前に maximum に達したので、一つ前の深さの結果を指す。
+    if it["elapsed"] > maximum
+      return [maximum, prev ? prev["move"] : it["move"], prev ? prev["depth"] : 0, false]
+    end
+
+    unstable = policy[:unstable] ? 1 + it["best_move_changes"] : 1
+    improving = policy[:improving] ? improving_factor(record, it) : 628
+    if record["root_moves"] == 1 || it["elapsed"] > optimum * unstable * improving / 628
+      return [it["elapsed"], it["move"], it["depth"], false]
+    end
+    prev = it
+  end
+
+  # 記録より長く考える配分。記録の最後の結果で代用する。
+  [[record["elapsed"], maximum].min, record["bestmove"], prev ? prev["depth"] : 0, true]
+end
+
+records = []
+ARGV.each do |file|
+  File.foreach(file) do |line|
+    record = JSON.parse(line)
+    records << record unless record["iterations"].empty?
+  end
+end
+
+if records.empty?
+  puts "no records"
+  exit
+end
+
+actual_time = records.inject(0) { |sum, r| sum + r["elapsed"] }
+printf("%d moves, actual time %.1f s\n\n", records.size, actual_time / 1000.0)
+printf("%-14s %10s %8s %10s %10s %10s\n", "policy", "time[s]", "ratio", "same[%]", "depth", "truncated")
+
+Policies.each do |policy|
+  time = 0.0
+  same = 0
+  depth = 0
+  truncated = 0
+  records.each do |record|
+    t, move, d, trunc = simulate(record, policy)
+    time += t
+    same += 1 if move == record["bestmove"]
+    depth += d
+    truncated += 1 if trunc
+  end
+  printf("%-14s %10.1f %8.3f %10.1f %10.2f %10d\n",
+         policy[:name], time / 1000.0, time / actual_time, 100.0 * same / records.size,
+         depth.to_f / records.size, truncated)
+end